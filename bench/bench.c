@@ -0,0 +1,331 @@
+/**
+ * @file bench.c
+ * @brief Benchmark sweeping sizes, numbers of threads and distributions of
+ *        the array within a single process.
+ * @author Marco Plaitano
+ * @date 13 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef _OPENMP
+    #include <omp.h>
+#else
+    #define omp_get_thread_num() 0
+    #define omp_get_num_threads() 1
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "counting_sort.h"
+#include "tuning.h"
+#include "util.h"
+
+
+/** @brief Maximum number of items in every list of the command line. */
+#define MAX_ITEMS 64
+
+
+/**
+ * @brief Split a comma separated list of integers.
+ * @param list:  The list.
+ * @param items: The integers (output); at most MAX_ITEMS.
+ * @return Number of integers read.
+ */
+static int parse_list(const char *list, long long *items) {
+    int n = 0;
+    for (const char *p = list; *p != '\0' && n < MAX_ITEMS; n++) {
+        char *end = NULL;
+        items[n] = strtoll(p, &end, 10);
+        if (end == p || items[n] < 1 || (*end != ',' && *end != '\0')) {
+            fprintf(stderr, "Invalid list '%s'.\n", list);
+            exit(EXIT_FAILURE);
+        }
+        p = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+
+/**
+ * @brief Split a comma separated list of distribution names.
+ * @param list:  The list; it is modified.
+ * @param names: The names (output), pointing into `list`; at most MAX_ITEMS.
+ * @param dists: The distributions (output).
+ * @return Number of distributions read.
+ */
+static int parse_distributions(char *list, char **names, distribution *dists) {
+    int n = 0;
+    for (char *name = strtok(list, ","); name != NULL && n < MAX_ITEMS;
+         name = strtok(NULL, ","), n++) {
+        names[n] = name;
+        dists[n] = distribution_parse(name);
+    }
+    return n;
+}
+
+
+/** @brief Compare two `double`s for qsort(). */
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+
+/**
+ * @brief Return the p-th percentile of sorted samples, by nearest rank.
+ * @param samples: The samples, in ascending order.
+ * @param n:       Number of samples.
+ * @param p:       Percentile, between 0 and 100.
+ */
+static double percentile(const double *samples, int n, double p) {
+    int rank = (int)(p / 100 * n + 0.5);
+    rank = rank < 1 ? 1 : (rank > n ? n : rank);
+    return samples[rank - 1];
+}
+
+
+/**
+ * @brief Copy an array, every thread copying the block it sorts.
+ * @param dst:      Destination.
+ * @param src:      Source.
+ * @param size:     Number of elements.
+ * @param nthreads: Number of threads.
+ */
+static void copy_array(int *dst, const int *src, long long size, int nthreads)
+{
+    #pragma omp parallel num_threads(nthreads) shared(dst, src, size)
+    {
+        long long nt = omp_get_num_threads();
+        long long t = omp_get_thread_num();
+        long long begin = BLOCK_BEGIN(size, t, nt);
+        memcpy(dst + begin, src + begin,
+               sizeof(int) * (BLOCK_BEGIN(size, t + 1, nt) - begin));
+    }
+}
+
+
+/**
+ * @brief Measure the memory bandwidth of the host with the Copy and Triad
+ *        kernels of the STREAM benchmark, printing the best one for every
+ *        number of threads as a CSV line.
+ * @param size:        Number of `double`s of every array; it should be well
+ *                     beyond the size of the last-level cache.
+ * @param threads:     Numbers of threads to measure with.
+ * @param nthreads:    Number of items of threads[].
+ * @param warmup:      Runs of every kernel not taken into account.
+ * @param repetitions: Runs of every kernel out of which the best is taken.
+ * @param policy:      Placement of the pages of the arrays.
+ *
+ * As in STREAM, the bytes moved are the ones read and written by the kernel
+ * (16 per element for Copy, 24 for Triad), so they are comparable with the
+ * ones counting_sort() has to move: this is the peak the analysis compares
+ * the sort against.
+ */
+static void stream_peak(long long size, const long long *threads,
+                        int nthreads, int warmup, int repetitions,
+                        alloc_policy policy)
+{
+    long long bytes = size * sizeof(double);
+    int max_threads = 0;
+    for (int t = 0; t < nthreads; t++)
+        max_threads = threads[t] > max_threads ? threads[t] : max_threads;
+
+    double *a = (double *)safe_alloc_policy(bytes, policy, max_threads);
+    double *b = (double *)safe_alloc_policy(bytes, policy, max_threads);
+    double *c = (double *)safe_alloc_policy(bytes, policy, max_threads);
+    long long i = 0;
+
+    #pragma omp parallel for num_threads(max_threads) schedule(static) \
+            shared(a, b, c) private(i)
+    for (i = 0; i < size; i++) {
+        a[i] = 1.0;
+        b[i] = 2.0;
+        c[i] = 0.0;
+    }
+
+    printf("threads;copy;triad\n");
+    for (int t = 0; t < nthreads; t++) {
+        int num_threads = threads[t];
+        double best_copy = 0, best_triad = 0;
+
+        for (int r = -warmup; r < repetitions; r++) {
+            double time_copy = 0, time_triad = 0;
+
+            START_TIME(time_copy);
+            #pragma omp parallel for num_threads(num_threads) \
+                    schedule(static) shared(a, c) private(i)
+            for (i = 0; i < size; i++)
+                c[i] = a[i];
+            END_TIME(time_copy);
+
+            START_TIME(time_triad);
+            #pragma omp parallel for num_threads(num_threads) \
+                    schedule(static) shared(a, b, c) private(i)
+            for (i = 0; i < size; i++)
+                a[i] = b[i] + 3.0 * c[i];
+            END_TIME(time_triad);
+
+            if (r < 0)
+                continue;
+            double copy = 2 * bytes / time_copy * 1e-9;
+            double triad = 3 * bytes / time_triad * 1e-9;
+            best_copy = copy > best_copy ? copy : best_copy;
+            best_triad = triad > best_triad ? triad : best_triad;
+        }
+        printf("%d;%.3f;%.3f\n", num_threads, best_copy, best_triad);
+        fflush(stdout);
+    }
+
+    safe_free_policy(a, bytes, policy);
+    safe_free_policy(b, bytes, policy);
+    safe_free_policy(c, bytes, policy);
+}
+
+
+int main(int argc, char **argv) {
+    alloc_policy policy = ALLOC_FIRST_TOUCH;
+    uint64_t seed = 0;
+    char default_dists[] = "uniform";
+    char *dist_list = default_dists;
+    int min = RANGE_MIN, max = RANGE_MAX;
+    int warmup = 3, repetitions = 20;
+    bool stream = false;
+    thread_affinity affinity = AFFINITY_NONE;
+    int opt = 0;
+
+    while ((opt = getopt(argc, argv, "a:bd:n:r:s:w:B:S:")) != -1) {
+        if (opt == 'a')
+            policy = alloc_policy_parse(optarg);
+        else if (opt == 'b')
+            stream = true;
+        else if (opt == 'd')
+            dist_list = optarg;
+        else if (opt == 'n')
+            repetitions = atoi(optarg);
+        else if (opt == 'r') {
+            if (sscanf(optarg, "%d:%d", &min, &max) != 2 || min > max)
+                argc = 0;
+        }
+        else if (opt == 's')
+            seed = strtoull(optarg, NULL, 10);
+        else if (opt == 'w')
+            warmup = atoi(optarg);
+        else if (opt == 'B')
+            affinity = affinity_parse(optarg);
+        else if (opt == 'S')
+            schedule_parse(optarg);
+        else
+            argc = 0;
+    }
+
+    if (argc - optind < 2 || repetitions < 1 || warmup < 0) {
+        fprintf(stderr, "usage: bench.out [-a default|first-touch|interleave] "
+                        "[-d dist[,dist...]] [-r min:max] [-s seed] "
+                        "[-w warmup] [-n repetitions] "
+                        "[-B none|compact|spread] [-S loop=kind[,chunk]] "
+                        "size[,size...] threads[,threads...]\n"
+                        "       bench.out -b [-a ...] [-w warmup] "
+                        "[-n repetitions] size threads[,threads...]\n");
+        return EXIT_FAILURE;
+    }
+
+    long long sizes[MAX_ITEMS], threads[MAX_ITEMS];
+    char *names[MAX_ITEMS];
+    distribution dists[MAX_ITEMS];
+    int nsizes = parse_list(argv[optind], sizes);
+    int nthreads = parse_list(argv[optind + 1], threads);
+    int ndists = parse_distributions(dist_list, names, dists);
+
+    if (stream) {
+        stream_peak(sizes[0], threads, nthreads, warmup, repetitions, policy);
+        return EXIT_SUCCESS;
+    }
+
+    long long max_size = 0;
+    int max_threads = 0;
+    for (int s = 0; s < nsizes; s++)
+        max_size = sizes[s] > max_size ? sizes[s] : max_size;
+    for (int t = 0; t < nthreads; t++)
+        max_threads = threads[t] > max_threads ? threads[t] : max_threads;
+
+    /*
+     * Every buffer is allocated, and its pages touched, once for the whole
+     * sweep: `source` keeps the generated values, copied into `array` before
+     * every sort out of the timed section.
+     */
+    long long bytes = max_size * sizeof(int);
+    int *source = (int *)safe_alloc_policy(bytes, policy, max_threads);
+    int *array = (int *)safe_alloc_policy(bytes, policy, max_threads);
+    double *samples = (double *)safe_alloc(sizeof(double) * repetitions);
+
+    printf("size;threads;distribution;repetitions;median;p05;p25;p75;p95;"
+           "min;max;throughput\n");
+
+    for (int t = 0; t < nthreads; t++) {
+        int num_threads = threads[t];
+        counting_sort_ctx *ctx = counting_sort_ctx_create(num_threads);
+        tuning_set_affinity(affinity, num_threads);
+        counting_sort_calibrate(num_threads);
+
+        for (int d = 0; d < ndists; d++) {
+            for (int s = 0; s < nsizes; s++) {
+                long long size = sizes[s];
+                array_init_distribution(source, size, min, max, dists[d],
+                                        seed, num_threads);
+
+                /* The first sorts grow the buffers of the context. */
+                for (int r = -warmup; r < repetitions; r++) {
+                    double time_sort = 0;
+                    copy_array(array, source, size, num_threads);
+                    START_TIME(time_sort);
+                    counting_sort_with_ctx(ctx, array, size);
+                    END_TIME(time_sort);
+                    if (r >= 0)
+                        samples[r] = time_sort;
+                }
+
+                qsort(samples, repetitions, sizeof(double), compare_double);
+                double median = percentile(samples, repetitions, 50);
+                printf("%lld;%d;%s;%d;%.6f;%.6f;%.6f;%.6f;%.6f;%.6f;%.6f;"
+                       "%.3f\n", size, num_threads, names[d], repetitions,
+                       median, percentile(samples, repetitions, 5),
+                       percentile(samples, repetitions, 25),
+                       percentile(samples, repetitions, 75),
+                       percentile(samples, repetitions, 95), samples[0],
+                       samples[repetitions - 1],
+                       size * sizeof(int) / median * 1e-9);
+                fflush(stdout);
+            }
+        }
+
+        counting_sort_ctx_destroy(ctx);
+    }
+
+    free(samples);
+    safe_free_policy(array, bytes, policy);
+    safe_free_policy(source, bytes, policy);
+    return EXIT_SUCCESS;
+}
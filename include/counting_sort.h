@@ -28,11 +28,58 @@
 #ifndef COUNTING_SORT_H
 #define COUNTING_SORT_H
 
+#include <stdint.h>
+
+#include "histogram.h"
+
+
+/**
+ * @brief Context owning all the memory needed by the sorting algorithms, and
+ *        the number of threads to use; meant to be reused across many sorts,
+ *        which then allocate nothing once the buffers are large enough.
+ */
+typedef struct counting_sort_ctx counting_sort_ctx;
+
+/** @brief Algorithm chosen to sort an array. */
+typedef enum {
+    /** Insertion Sort, for arrays too small to be worth counting. */
+    STRATEGY_INSERTION,
+    /** Counting Sort on the whole range of the values. */
+    STRATEGY_DENSE,
+    /** Counting Sort on the band holding most values; the rest on its own. */
+    STRATEGY_OUTLIER_SPLIT,
+    /** Counting in hash tables, for few distinct values over a wide range. */
+    STRATEGY_SPARSE,
+    /** Radix Sort, for many distinct values over a wide range. */
+    STRATEGY_RADIX
+} sort_strategy;
+
+
+/** @brief How an array was sorted, and what it was found to look like. */
+typedef struct {
+    /** The algorithm. */
+    sort_strategy strategy;
+    /** Range of the histogram, for the Counting Sort strategies; else 0. */
+    long long min;
+    long long max;
+    /** Number of values sorted apart from the histogram. */
+    long long outliers;
+    /** Estimated number of distinct values; -1 if not estimated. */
+    long long distinct;
+} sort_decision;
+
+
 
 /**
  * @brief Sort the given array using Counting Sort Algorithm.
  *
- * The array is sorted in-place.
+ * The array is sorted in-place. If the range of the values turns out to be
+ * much wider than the array, radix_sort() (or sparse_sort(), when the values
+ * are few and repeated many times) is used instead, so that the memory needed
+ * never exceeds a few times the size of the array. A range widened only by a
+ * few outliers, seen in a sample taken before counting, is not: the values
+ * in the band holding most of the sample are counted, the others sorted on
+ * their own.
  * @param array:    The input array.
  * @param size:     The size of the array.
  * @param nthreads: Number of threads to use when OpenMP parallelization is
@@ -40,5 +87,261 @@
  */
 void counting_sort(int *array, long long size, int nthreads);
 
+/**
+ * @brief Sort the given array, whose values are known to be in the range
+ *        [min; max], using Counting Sort Algorithm.
+ *
+ * The array is sorted in-place. Since the range is given, the array is read
+ * only once before being overwritten.
+ * @param array:    The input array.
+ * @param size:     The size of the array.
+ * @param min:      Minimum value that can be stored in the array.
+ * @param max:      Maximum value that can be stored in the array.
+ * @param nthreads: Number of threads to use when OpenMP parallelization is
+ *                  enabled.
+ */
+void counting_sort_range(int *array, long long size, int min, int max,
+                         int nthreads);
+
+/**
+ * @brief Write the values of the given array, sorted, into another array,
+ *        using Counting Sort Algorithm.
+ *
+ * The input is only read (so it can be, for example, a read-only mapped
+ * file) and the sorted values are written once, straight into `out`, with no
+ * intermediate copy. Ranges too wide for Counting Sort are sorted by copying
+ * the array into `out` first and sorting it in place as counting_sort() does.
+ * @param array:    The input array.
+ * @param out:      Array of `size` elements to store the sorted values in.
+ * @param size:     The size of the arrays.
+ * @param nthreads: Number of threads to use when OpenMP parallelization is
+ *                  enabled.
+ */
+void counting_sort_copy(const int *array, int *out, long long size,
+                        int nthreads);
+
+/**
+ * @brief Turn the occurrences stored in count[] into starting positions.
+ * @param count:      The array of occurrences.
+ * @param count_size: Number of elements stored in count[].
+ * @param width:      Width of the counters in count[].
+ * @param offset:     Array of `count_size + 1` elements (output); offset[i] is
+ *                    the index of the first occurrence of the i-th value in
+ *                    the sorted array, offset[count_size] is the array size.
+ *
+ * The positions are 64-bit whatever the width of the counters, so that 32-bit
+ * counters whose total exceeds 2^32 do not wrap around. The scan is kept
+ * serial: it is O(count_size) and it is a tiny fraction of the time spent in
+ * the other phases.
+ */
+void counting_sort_offsets(const void *count, long long count_size,
+                           count_width width, long long *offset);
+
+/**
+ * @brief Write a window of the sorted array described by a histogram.
+ * @param out:        Array of `n` elements to store the window in.
+ * @param first:      Position, in the whole sorted array, of out[0].
+ * @param n:          Number of elements of the window.
+ * @param offset:     Starting position of every value in the whole sorted
+ *                    array: `count_size + 1` items, the exclusive prefix sum
+ *                    of the histogram followed by its total.
+ * @param count_size: Number of values in the histogram.
+ * @param min:        Value associated to offset[0].
+ * @param nthreads:   Number of threads to use when OpenMP parallelization is
+ *                    enabled.
+ *
+ * This is the write-back of counting_sort(), for a sorted array too large to
+ * be written at once (a file, or an array split among many processes).
+ */
+void counting_sort_fill(int *out, long long first, long long n,
+                        const long long *offset, long long count_size,
+                        int min, int nthreads);
+
+/**
+ * @brief Create a new context, with no memory reserved yet.
+ * @param nthreads: Number of threads to use when OpenMP parallelization is
+ *                  enabled.
+ * @return The context; to be released with counting_sort_ctx_destroy().
+ */
+counting_sort_ctx *counting_sort_ctx_create(int nthreads);
+
+/**
+ * @brief Reserve, in advance, the memory needed to sort an array with the
+ *        given size and range of values.
+ *
+ * Optional: counting_sort_with_ctx() grows the buffers on its own when needed;
+ * they never shrink.
+ * @param ctx:        The context.
+ * @param size:       Size of the array.
+ * @param count_size: Number of values in the range [min; max] of the array.
+ */
+void counting_sort_ctx_reserve(counting_sort_ctx *ctx, long long size,
+                               long long count_size);
+
+/**
+ * @brief Release the context and all its memory.
+ * @param ctx: The context; can be NULL.
+ */
+void counting_sort_ctx_destroy(counting_sort_ctx *ctx);
+
+/**
+ * @brief Same as counting_sort(), using the memory and the number of threads
+ *        of the given context.
+ * @param ctx:   The context.
+ * @param array: The input array.
+ * @param size:  The size of the array.
+ *
+ * Arrays with few distinct values spread over a wide range, which are sorted
+ * by sparse_sort(), still allocate their hash tables.
+ */
+void counting_sort_with_ctx(counting_sort_ctx *ctx, int *array,
+                            long long size);
+
+/**
+ * @brief Tell how the last array sorted with the context was sorted.
+ * @param ctx: The context.
+ * @return The decision; it stays valid until the next sort with the context.
+ */
+const sort_decision *counting_sort_ctx_decision(const counting_sort_ctx *ctx);
+
+/**
+ * @brief Return the name of a strategy, as printed by `main.out -e`.
+ * @param strategy: The strategy.
+ * @return The name.
+ */
+const char *strategy_name(sort_strategy strategy);
+
+/**
+ * @brief Sort many independent arrays at once, using Counting Sort Algorithm.
+ * @param arrays:   The arrays.
+ * @param sizes:    Number of elements stored in every array.
+ * @param narrays:  Number of arrays.
+ * @param nthreads: Number of threads to use when OpenMP parallelization is
+ *                  enabled.
+ *
+ * Every array becomes one or more OpenMP tasks of a single team. Arrays up to
+ * a fair share of the batch (the total size over the number of threads) are
+ * sorted serially by one task each; larger ones are split into a task per
+ * block for every phase. The threads are started once for the whole batch
+ * and, since the phases of different arrays are not synchronized with each
+ * other, the histogram of an array is built while another is written back.
+ */
+void counting_sort_batch(int **arrays, const long long *sizes, int narrays,
+                         int nthreads);
+
+/**
+ * @brief Measure the costs used to choose how to sort small arrays.
+ *
+ * counting_sort() and counting_sort_with_ctx() run the calibration on their
+ * own the first time they are called, and measure the cost of starting the
+ * threads the first time they are called with a certain number of them (the
+ * results are kept for every number): call this function at startup to keep
+ * that time out of the first sort.
+ * @param nthreads: Number of threads the sorts will be run with.
+ */
+void counting_sort_calibrate(int nthreads);
+
+/**
+ * @brief Set the costs used to choose how to sort small arrays, instead of
+ *        measuring them with counting_sort_calibrate().
+ * @param insertion_cost:   Seconds per comparison of Insertion Sort.
+ * @param element_cost:     Seconds per element of serial Counting Sort.
+ * @param bucket_cost:      Seconds per bucket of serial Counting Sort.
+ * @param serial_threshold: Maximum size of the arrays sorted without starting
+ *                          any thread.
+ * @param nthreads:         Number of threads `serial_threshold` refers to; the
+ *                          one of any other number is measured when needed.
+ */
+void counting_sort_set_thresholds(double insertion_cost, double element_cost,
+                                  double bucket_cost,
+                                  long long serial_threshold, int nthreads);
+
+/**
+ * @brief Same as counting_sort(), for arrays of 8-bit unsigned integers.
+ */
+void counting_sort_u8(uint8_t *array, long long size, int nthreads);
+
+/**
+ * @brief Same as counting_sort(), for arrays of 16-bit unsigned integers.
+ */
+void counting_sort_u16(uint16_t *array, long long size, int nthreads);
+
+/**
+ * @brief Same as counting_sort(), for arrays of 64-bit signed integers.
+ *
+ * The program exits if the range [min; max] of the values is too wide for
+ * their histogram to be allocated.
+ */
+void counting_sort_i64(int64_t *array, long long size, int nthreads);
+
+/**
+ * @brief Sort an array of fixed-size records by an integer key, using
+ *        Counting Sort Algorithm.
+ *
+ * The sort is stable: records sharing the same key keep their relative order.
+ * Records can not be rebuilt from their keys, so they are copied into a
+ * different buffer.
+ * @param records:     The input array.
+ * @param out:         Array of `size` records in which to write the sorted
+ *                     records (output); must not overlap `records`.
+ * @param size:        Number of records.
+ * @param record_size: Size, in bytes, of a single record.
+ * @param key:         Function returning the key of a record.
+ * @param nthreads:    Number of threads to use when OpenMP parallelization is
+ *                     enabled.
+ */
+void counting_sort_records(const void *records, void *out, long long size,
+                           long long record_size, key_extractor key,
+                           int nthreads);
+
+/**
+ * @brief Same as counting_sort_records(), without moving the records: the
+ *        sorted order is given as a permutation instead.
+ *
+ * After the call, records[perm[0]], records[perm[1]], ... are sorted (stably)
+ * by key; the same permutation can be applied to other arrays later on.
+ * @param records:     The input array.
+ * @param perm:        Array of `size` indexes (output).
+ * @param size:        Number of records.
+ * @param record_size: Size, in bytes, of a single record.
+ * @param key:         Function returning the key of a record.
+ * @param nthreads:    Number of threads to use when OpenMP parallelization is
+ *                     enabled.
+ */
+void counting_sort_records_perm(const void *records, long long *perm,
+                                long long size, long long record_size,
+                                key_extractor key, int nthreads);
+
+/**
+ * @brief Sort an array of keys, together with the values associated to them,
+ *        using a stable Counting Sort.
+ * @param keys:       The keys.
+ * @param values:     Array of `size` values, values[i] being associated to
+ *                    keys[i].
+ * @param size:       Number of keys.
+ * @param value_size: Size, in bytes, of a single value.
+ * @param keys_out:   Array of `size` items in which to write the sorted keys
+ *                    (output), or NULL if they are not needed.
+ * @param values_out: Array of `size` values in which to write the values in
+ *                    the order of their keys (output).
+ * @param nthreads:   Number of threads to use when OpenMP parallelization is
+ *                    enabled.
+ */
+void counting_sort_by_key(const int *keys, const void *values, long long size,
+                          long long value_size, int *keys_out,
+                          void *values_out, int nthreads);
+
+/**
+ * @brief Compute the permutation which stably sorts an array of keys.
+ * @param keys:     The keys; they are not modified.
+ * @param perm:     Array of `size` indexes (output); keys[perm[0]],
+ *                  keys[perm[1]], ... are sorted.
+ * @param size:     Number of keys.
+ * @param nthreads: Number of threads to use when OpenMP parallelization is
+ *                  enabled.
+ */
+void counting_sort_perm(const int *keys, long long *perm, long long size,
+                        int nthreads);
+
 
 #endif /* COUNTING_SORT_H */
@@ -0,0 +1,240 @@
+/**
+ * @file histogram.h
+ * @brief This file provides the functions that count the occurrences of the
+ *        values stored in an array, on which Counting Sort is built.
+ * @author Marco Plaitano
+ * @date 29 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+/** @brief Size, in bytes, of a cache line. */
+#define CACHE_LINE_SIZE 64
+
+/**
+ * @brief Minimum ratio between the number of buckets and the number of elements
+ *        each thread counts for HISTOGRAM_AUTO to choose HISTOGRAM_ATOMIC.
+ */
+#define ATOMIC_RATIO 8
+
+/**
+ * @brief Size, in bytes, of the private histogram of a thread above which
+ *        HISTOGRAM_AUTO chooses HISTOGRAM_NARROW; a share of L2 that leaves
+ *        room for the array streaming through it.
+ */
+#define NARROW_CACHE_BYTES (256 * 1024)
+
+
+/** @brief Widths available for the counters of a histogram. */
+typedef enum {
+    /** uint32_t counters: enough for arrays of less than 2^32 elements. */
+    COUNT_32,
+    /** uint64_t counters. */
+    COUNT_64
+} count_width;
+
+
+/** @brief Types of integer elements that can be counted. */
+typedef enum {
+    ELEM_U8,
+    ELEM_U16,
+    ELEM_I32,
+    ELEM_I64
+} elem_type;
+
+
+/**
+ * @brief Function returning the key of a record, i.e. the integer by which
+ *        records are sorted.
+ * @param record: Pointer to the record.
+ * @return The key of the record.
+ */
+typedef long long (*key_extractor)(const void *record);
+
+
+/** @brief Strategies available to build a histogram in parallel. */
+typedef enum {
+    /** Choose one of the following based on range and array size. */
+    HISTOGRAM_AUTO,
+    /**
+     * Every thread counts into its own histogram; the histograms are then
+     * merged by the threads together, each one summing a different range of
+     * buckets.
+     */
+    HISTOGRAM_PRIVATE,
+    /** All threads increment the same histogram with atomic operations. */
+    HISTOGRAM_ATOMIC,
+    /**
+     * Same as HISTOGRAM_PRIVATE, with private histograms of uint16_t (or
+     * uint8_t, if they would not fit in NARROW_CACHE_BYTES) counters; a
+     * counter that wraps around spills its occurrences into the shared
+     * histogram.
+     */
+    HISTOGRAM_NARROW
+} histogram_mode;
+
+
+/**
+ * @brief Choose the width of the counters needed to count an array.
+ * @param size: Number of elements stored in the array.
+ * @return COUNT_32 if no counter can overflow 32 bits; COUNT_64 otherwise.
+ *
+ * The narrower counters are preferred whenever possible, since the smaller the
+ * histogram, the more of it stays in cache.
+ */
+count_width histogram_width(long long size);
+
+/**
+ * @brief Return the size, in bytes, of a single counter of the given width.
+ * @param width: Width of the counters.
+ * @return sizeof(uint32_t) or sizeof(uint64_t).
+ */
+long long count_item_size(count_width width);
+
+/**
+ * @brief Count the occurrences of every value of the array in the range
+ *        [min; min + count_size - 1].
+ * @param array:      The array.
+ * @param size:       Number of elements stored in the array.
+ * @param min:        Value associated to count[0].
+ * @param count:      Array of `count_size` counters, of the given width, in
+ *                    which to store the occurrences (output); it does not need
+ *                    to be initialized.
+ * @param count_size: Number of items in count[].
+ * @param width:      Width of the counters in count[].
+ * @param out_min:    If not NULL, smallest value found outside of the range
+ *                    (output); left untouched if there is none.
+ * @param out_max:    If not NULL, largest value found outside of the range
+ *                    (output); left untouched if there is none.
+ * @param mode:       Strategy to use.
+ * @param nthreads:   Number of threads to use when OpenMP parallelization is
+ *                    enabled.
+ * @return Number of elements found outside of the range, which were not
+ *         counted.
+ */
+long long histogram_build(const int *array, long long size, int min,
+                          void *count, long long count_size, count_width width,
+                          int *out_min, int *out_max, histogram_mode mode,
+                          int nthreads);
+
+/**
+ * @brief Return the number of bytes of scratch memory needed by
+ *        histogram_build_scratch() for the private histograms.
+ * @param count_size: Number of items in the histogram.
+ * @param width:      Width of the counters.
+ * @param nthreads:   Number of threads that will build the histogram; 0 (or
+ *                    less) for the default team, as sized by team_size().
+ * @return Number of bytes.
+ */
+long long histogram_scratch_size(long long count_size, count_width width,
+                                 int nthreads);
+
+/**
+ * @brief Same as histogram_build(), using the given memory for the private
+ *        histograms instead of allocating it.
+ * @param scratch: At least histogram_scratch_size() bytes, aligned to
+ *                 CACHE_LINE_SIZE; it is not used with HISTOGRAM_ATOMIC.
+ *
+ * All the other parameters and the return value are the same as
+ * histogram_build().
+ */
+long long histogram_build_scratch(const int *array, long long size, int min,
+                                  void *count, long long count_size,
+                                  count_width width, int *out_min,
+                                  int *out_max, void *scratch,
+                                  histogram_mode mode, int nthreads);
+
+/**
+ * @brief Same as histogram_build(), for an array of any of the integer types
+ *        in elem_type.
+ * @param array: The array.
+ * @param type:  Type of the elements of the array.
+ *
+ * All the other parameters and the return value are the same as
+ * histogram_build().
+ */
+long long histogram_build_typed(const void *array, elem_type type,
+                                long long size, long long min, void *count,
+                                long long count_size, count_width width,
+                                long long *out_min, long long *out_max,
+                                histogram_mode mode, int nthreads);
+
+/**
+ * @brief Same as histogram_build(), counting the keys of an array of records.
+ * @param records:     The array of records.
+ * @param size:        Number of records.
+ * @param record_size: Size, in bytes, of a single record.
+ * @param key:         Function returning the key of a record.
+ *
+ * All the other parameters and the return value are the same as
+ * histogram_build(); `min` and the range refer to the keys.
+ */
+long long histogram_build_records(const void *records, long long size,
+                                  long long record_size, key_extractor key,
+                                  long long min, void *count,
+                                  long long count_size, count_width width,
+                                  long long *out_min, long long *out_max,
+                                  histogram_mode mode, int nthreads);
+
+/**
+ * @brief Split the array into blocks and build a separate histogram for each
+ *        of them.
+ *
+ * Block t is made of the elements in the range
+ * [size * t / nblocks; size * (t + 1) / nblocks - 1]. Unlike the other
+ * functions, every element must be in the range [min; min + count_size - 1].
+ * @param array:      The array.
+ * @param type:       Type of the elements of the array.
+ * @param size:       Number of elements stored in the array.
+ * @param min:        Value associated to the first bucket of every histogram.
+ * @param blocks:     Array of `nblocks * count_size` counters, of the given
+ *                    width (output); the histogram of block t starts at item
+ *                    `t * count_size`.
+ * @param count_size: Number of buckets in every histogram.
+ * @param width:      Width of the counters in blocks[].
+ * @param nblocks:    Number of blocks.
+ * @param nthreads:   Number of threads to use when OpenMP parallelization is
+ *                    enabled.
+ */
+void histogram_blocks_typed(const void *array, elem_type type, long long size,
+                            long long min, void *blocks, long long count_size,
+                            count_width width, long long nblocks, int nthreads);
+
+/**
+ * @brief Same as histogram_blocks_typed(), counting the keys of an array of
+ *        records.
+ * @param records:     The array of records.
+ * @param size:        Number of records.
+ * @param record_size: Size, in bytes, of a single record.
+ * @param key:         Function returning the key of a record.
+ *
+ * All the other parameters are the same as histogram_blocks_typed().
+ */
+void histogram_blocks_records(const void *records, long long size,
+                              long long record_size, key_extractor key,
+                              long long min, void *blocks,
+                              long long count_size, count_width width,
+                              long long nblocks, int nthreads);
+
+
+#endif /* HISTOGRAM_H */
@@ -0,0 +1,63 @@
+/**
+ * @file mpi_sort.h
+ * @brief This file contains the functions needed to sort an array split among
+ *        MPI processes, using Counting Sort Algorithm.
+ * @author Marco Plaitano
+ * @date 13 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef MPI_SORT_H
+#define MPI_SORT_H
+
+#include <mpi.h>
+
+/**
+ * @brief Maximum range of the values sorted by mpi_counting_sort(); the
+ *        histogram, of 64-bit counters, takes 2GB on every process.
+ */
+#define MPI_SORT_MAX_RANGE (1LL << 28)
+
+
+/**
+ * @brief Sort an array split among the processes of a communicator, using
+ *        Counting Sort Algorithm.
+ * @param array:    The part of the array owned by the calling process.
+ * @param size:     Number of elements in the part; it can differ from one
+ *                  process to another.
+ * @param comm:     The communicator.
+ * @param nthreads: Number of threads to use when OpenMP parallelization is
+ *                  enabled.
+ *
+ * The array is sorted in-place: once done, the parts of the processes, taken
+ * by rank, form the sorted array, each keeping its own size. Every process
+ * counts its part with the OpenMP histogram kernel; the histograms are then
+ * summed with MPI_Allreduce() and each process writes its slice of the
+ * sorted array from the total. Only the range of the values is exchanged, so
+ * the communication does not depend on the size of the array.
+ * Collective: it must be called by all the processes of `comm`.
+ */
+void mpi_counting_sort(int *array, long long size, MPI_Comm comm,
+                       int nthreads);
+
+
+#endif /* MPI_SORT_H */
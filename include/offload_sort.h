@@ -0,0 +1,114 @@
+/**
+ * @file offload_sort.h
+ * @brief This file contains the functions needed to sort arrays on an
+ *        accelerator (e.g. a GPU), using Counting Sort Algorithm.
+ * @author Marco Plaitano
+ * @date 13 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef OFFLOAD_SORT_H
+#define OFFLOAD_SORT_H
+
+/**
+ * @brief Maximum number of values counted in the shared memory of a team;
+ *        wider ranges are counted straight into the global histogram.
+ */
+#define OFFLOAD_LOCAL_BUCKETS 4096
+
+/**
+ * @brief Maximum range of the values sorted on the device; the histogram and
+ *        the offsets, of 64-bit counters, take 4GB of device memory.
+ */
+#define OFFLOAD_MAX_RANGE (1LL << 28)
+
+
+/**
+ * @brief Buffers reserved on the device and reused by every sort offloaded
+ *        with them, so that they are allocated only once for a whole batch.
+ */
+typedef struct offload_ctx offload_ctx;
+
+
+/**
+ * @brief Create a new context, with no memory reserved on the device yet.
+ * @param nthreads: Number of threads to use on the host, when the range of
+ *                  an array is too wide to sort it on the device.
+ * @return The context; to be released with offload_ctx_destroy().
+ *
+ * The default device is used; without one (or when the program is not
+ * compiled for offloading) the kernels run on the host.
+ */
+offload_ctx *offload_ctx_create(int nthreads);
+
+/**
+ * @brief Release the context and the device memory it holds.
+ * @param ctx: The context.
+ */
+void offload_ctx_destroy(offload_ctx *ctx);
+
+/**
+ * @brief Make sure the buffers of the context can hold an array of `size`
+ *        elements whose values span `count_size` counters.
+ * @param ctx:        The context.
+ * @param size:       Number of elements of the array.
+ * @param count_size: Number of counters of the histogram; 0 to only grow the
+ *                    array. Ranges wider than OFFLOAD_MAX_RANGE, sorted on
+ *                    the host, reserve nothing.
+ *
+ * The buffers only grow, so sorting arrays no larger than the reserved ones
+ * never allocates device memory.
+ */
+void offload_ctx_reserve(offload_ctx *ctx, long long size,
+                         long long count_size);
+
+/**
+ * @brief Sort the given array on the device using Counting Sort Algorithm.
+ * @param ctx:   The context.
+ * @param array: The array, in host memory.
+ * @param size:  Number of elements stored in the array.
+ *
+ * The array is copied to the device, where min and max are found, the values
+ * counted in histograms private to every team (merged into the global one),
+ * the starting positions computed by a parallel scan and the array written
+ * back in parallel slices, before being copied back. If the range is much
+ * wider than the array (or wider than OFFLOAD_MAX_RANGE), it is sorted on the
+ * host with counting_sort() instead.
+ */
+void offload_counting_sort(offload_ctx *ctx, int *array, long long size);
+
+/**
+ * @brief Sort many arrays on the device, one after the other, reusing the
+ *        same device buffers.
+ * @param ctx:     The context.
+ * @param arrays:  The arrays, in host memory.
+ * @param sizes:   Number of elements stored in every array.
+ * @param narrays: Number of arrays.
+ *
+ * The buffers are grown once to fit the largest array, so no device memory
+ * is allocated while sorting.
+ */
+void offload_counting_sort_batch(offload_ctx *ctx, int **arrays,
+                                 const long long *sizes, int narrays);
+
+
+#endif /* OFFLOAD_SORT_H */
@@ -0,0 +1,120 @@
+/**
+ * @file profile.h
+ * @brief This file contains the functions needed to measure the time (and
+ *        hardware events) spent by every thread in each phase of the sort.
+ * @author Marco Plaitano
+ * @date 13 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+
+/**
+ * @brief Phases of Counting Sort measured separately.
+ *
+ * - PHASE_MIN_MAX:   finding (or guessing) the range of the values.
+ * - PHASE_ZERO_FILL: clearing the histograms.
+ * - PHASE_HISTOGRAM: counting the occurrences of the values.
+ * - PHASE_MERGE:     summing the private histograms of the threads.
+ * - PHASE_SCATTER:   computing the starting positions and writing the sorted
+ *                    array.
+ */
+typedef enum {
+    PHASE_MIN_MAX,
+    PHASE_ZERO_FILL,
+    PHASE_HISTOGRAM,
+    PHASE_MERGE,
+    PHASE_SCATTER,
+    NUM_PHASES
+} phase;
+
+
+/**
+ * @brief Start profiling the phases run by up to `nthreads` threads,
+ *        discarding any previous measure.
+ * @param nthreads: Number of threads the sort is going to use; 0 (or less)
+ *                  for the default team, as sized by team_size().
+ *
+ * Every thread also opens its own perf_event counters of CPU cycles and
+ * last-level cache misses; when the kernel does not allow it (see
+ * /proc/sys/kernel/perf_event_paranoid) only the time is measured.
+ */
+void profile_start(int nthreads);
+
+/**
+ * @brief Stop profiling; the measures taken stay available until the next
+ *        call to profile_start().
+ */
+void profile_stop(void);
+
+/**
+ * @brief Mark the beginning of a phase for the calling thread.
+ * @param p: The phase.
+ *
+ * It does nothing (apart from a test) while not profiling, so it is cheap
+ * enough to be left in the sort.
+ */
+void profile_begin(phase p);
+
+/**
+ * @brief Mark the end of a phase for the calling thread, adding the time (and
+ *        the events) since profile_begin() to the ones of the phase.
+ * @param p: The phase.
+ */
+void profile_end(phase p);
+
+/**
+ * @brief Return the seconds spent by a thread in a phase since profiling
+ *        started.
+ * @param p:      The phase.
+ * @param thread: Number of the thread.
+ */
+double profile_seconds(phase p, int thread);
+
+/**
+ * @brief Return `true` if the hardware counters could be opened.
+ */
+bool profile_has_counters(void);
+
+/**
+ * @brief Return the name of a phase, as used in the CSV output.
+ * @param p: The phase.
+ */
+const char *phase_name(phase p);
+
+/**
+ * @brief Append the measures to a CSV line.
+ * @param out: The stream to write to.
+ *
+ * For every thread, and every phase in the order of the `phase` enum, three
+ * fields are written, each preceded by ';': seconds, CPU cycles and bytes
+ * moved from memory (last-level cache misses times CACHE_LINE_SIZE); the
+ * last two are -1 without hardware counters.
+ */
+void profile_print(FILE *out);
+
+
+#endif /* PROFILE_H */
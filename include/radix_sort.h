@@ -0,0 +1,68 @@
+/**
+ * @file radix_sort.h
+ * @brief This file provides the user a function to sort an array of integers
+ *        using LSD Radix Sort, built on top of counting passes.
+ * @author Marco Plaitano
+ * @date 29 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+/**
+ * @brief Number of bits of each digit; either 8 (4 passes over the array) or
+ *        11 (3 passes, with larger histograms).
+ */
+#define RADIX_BITS 11
+
+/** @brief Number of different values a digit can take. */
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+
+
+/**
+ * @brief Sort the given array using LSD Radix Sort Algorithm.
+ *
+ * The array is sorted in-place, with one counting pass per digit of RADIX_BITS
+ * bits; unlike counting_sort(), the memory needed does not depend on the range
+ * of the values but only on the size of the array.
+ * @param array:    The input array.
+ * @param size:     The size of the array.
+ * @param nthreads: Number of threads to use when OpenMP parallelization is
+ *                  enabled.
+ */
+void radix_sort(int *array, long long size, int nthreads);
+
+/**
+ * @brief Same as radix_sort(), using the given memory instead of allocating
+ *        it.
+ * @param array:    The input array.
+ * @param size:     The size of the array.
+ * @param buffer:   Auxiliary array of `size` elements.
+ * @param offset:   Array of `RADIX_BUCKETS * team_size(nthreads)` items.
+ * @param nthreads: Number of threads to use when OpenMP parallelization is
+ *                  enabled.
+ */
+void radix_sort_workspace(int *array, long long size, int *buffer,
+                          long long *offset, int nthreads);
+
+
+#endif /* RADIX_SORT_H */
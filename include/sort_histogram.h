@@ -0,0 +1,131 @@
+/**
+ * @file sort_histogram.h
+ * @brief This file contains a histogram kept across many batches of values,
+ *        from which their sorted sequence, or part of it, can be generated.
+ * @author Marco Plaitano
+ * @date 13 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SORT_HISTOGRAM_H
+#define SORT_HISTOGRAM_H
+
+/**
+ * @brief Maximum range of the values of a histogram; its 64-bit counters
+ *        take 2GB.
+ */
+#define HISTOGRAM_MAX_RANGE (1LL << 28)
+
+
+/**
+ * @brief Occurrences of every value of a multiset of `int`s, built one batch
+ *        at a time; the counters of Counting Sort, kept between sorts.
+ */
+typedef struct sort_histogram sort_histogram;
+
+
+/**
+ * @brief Create a new, empty, histogram.
+ * @param nthreads: Number of threads to use when OpenMP parallelization is
+ *                  enabled.
+ * @return The histogram; to be released with sort_histogram_destroy().
+ */
+sort_histogram *sort_histogram_create(int nthreads);
+
+/**
+ * @brief Release the histogram and all its memory.
+ * @param hist: The histogram; can be NULL.
+ */
+void sort_histogram_destroy(sort_histogram *hist);
+
+/**
+ * @brief Count the values of a batch into the histogram.
+ * @param hist:  The histogram.
+ * @param batch: The values.
+ * @param size:  Number of values in the batch.
+ *
+ * The range of the histogram grows to hold every value added, exiting the
+ * program when it would exceed HISTOGRAM_MAX_RANGE. Batches much smaller than
+ * the range are counted by a single thread, in time proportional to their
+ * size; larger ones are counted by all threads with histogram_build().
+ */
+void sort_histogram_add(sort_histogram *hist, const int *batch,
+                        long long size);
+
+/**
+ * @brief Take the values of a batch, added before, out of the histogram.
+ * @param hist:  The histogram.
+ * @param batch: The values.
+ * @param size:  Number of values in the batch.
+ *
+ * The program exits if a value occurs more times than it was added.
+ */
+void sort_histogram_remove(sort_histogram *hist, const int *batch,
+                           long long size);
+
+/**
+ * @brief Add all the values counted in a histogram to another one.
+ * @param dst: The histogram to add the values to.
+ * @param src: The histogram whose values to add; left untouched.
+ */
+void sort_histogram_merge(sort_histogram *dst, const sort_histogram *src);
+
+/**
+ * @brief Return the number of values in the histogram.
+ * @param hist: The histogram.
+ * @return The number of values, counting every occurrence.
+ */
+long long sort_histogram_size(const sort_histogram *hist);
+
+/**
+ * @brief Write the values of the histogram, sorted, into an array.
+ * @param hist: The histogram.
+ * @param out:  Array of sort_histogram_size() items (output).
+ */
+void sort_histogram_materialize(sort_histogram *hist, int *out);
+
+/**
+ * @brief Write a slice of the sorted values of the histogram into an array.
+ * @param hist:  The histogram.
+ * @param out:   Array of `last - first` items (output).
+ * @param first: Position, in the sorted sequence, of the first value to write.
+ * @param last:  Position right after the last value to write; at most
+ *               sort_histogram_size().
+ *
+ * The starting positions of the values are computed again, in O(range), only
+ * after the histogram has changed; the slice then takes time proportional to
+ * its size, plus a binary search for every thread.
+ */
+void sort_histogram_materialize_range(sort_histogram *hist, int *out,
+                                      long long first, long long last);
+
+/**
+ * @brief Write the `k` largest values of the histogram, sorted, into an
+ *        array; same as the last `k` positions of
+ *        sort_histogram_materialize_range().
+ * @param hist: The histogram.
+ * @param out:  Array of `k` items (output).
+ * @param k:    Number of values to write; at most sort_histogram_size().
+ */
+void sort_histogram_top(sort_histogram *hist, int *out, long long k);
+
+
+#endif /* SORT_HISTOGRAM_H */
@@ -0,0 +1,66 @@
+/**
+ * @file sparse_sort.h
+ * @brief This file provides the user a function to sort an array of integers
+ *        holding few distinct values spread over a wide range, by counting
+ *        them in hash tables.
+ * @author Marco Plaitano
+ * @date 29 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPARSE_SORT_H
+#define SPARSE_SORT_H
+
+/**
+ * @brief Maximum number of distinct values for sparse_sort() to be preferred
+ *        over radix_sort(); the hash tables stay small enough for the cache.
+ */
+#define SPARSE_MAX_DISTINCT (1 << 16)
+
+
+/**
+ * @brief Estimate the number of distinct values stored in the array.
+ * @param array: The array.
+ * @param size:  Number of elements stored in the array.
+ * @return Estimated number of distinct values, never above `size`.
+ *
+ * The estimate is based on how many values are found once or twice in a
+ * sample of the array.
+ */
+long long estimate_distinct(const int *array, long long size);
+
+/**
+ * @brief Sort the given array by counting its values in hash tables.
+ *
+ * The array is sorted in-place. Every thread counts its part of the array in
+ * its own open-addressing hash table; the tables are then merged, only the
+ * distinct values are sorted and, at last, they are expanded back into the
+ * array. Memory and time do not depend on the range of the values but on the
+ * number of distinct ones.
+ * @param array:    The input array.
+ * @param size:     The size of the array.
+ * @param nthreads: Number of threads to use when OpenMP parallelization is
+ *                  enabled.
+ */
+void sparse_sort(int *array, long long size, int nthreads);
+
+
+#endif /* SPARSE_SORT_H */
@@ -0,0 +1,66 @@
+/**
+ * @file stream_sort.h
+ * @brief This file contains the functions needed to sort files larger than
+ *        the memory, using Counting Sort Algorithm.
+ * @author Marco Plaitano
+ * @date 13 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef STREAM_SORT_H
+#define STREAM_SORT_H
+
+#include "sort_histogram.h"
+
+/** @brief Default size, in bytes, of the chunks read and written at once. */
+#define STREAM_CHUNK_BYTES (64LL << 20)
+
+/**
+ * @brief Maximum range of the values of a file sorted by stream_sort_file();
+ *        the one of its sort_histogram.
+ */
+#define STREAM_MAX_RANGE HISTOGRAM_MAX_RANGE
+
+
+/**
+ * @brief Sort a raw binary file of `int`s into another file, using Counting
+ *        Sort Algorithm, without holding the file in memory.
+ * @param input:       Path to the file to sort.
+ * @param output:      Path to the file to write the sorted values in; it is
+ *                     created, or truncated.
+ * @param chunk_bytes: Size, in bytes, of the chunks read and written at once;
+ *                     rounded down to a multiple of `sizeof(int)`.
+ * @param nthreads:    Number of threads to use when OpenMP parallelization is
+ *                     enabled.
+ * @return Number of elements sorted.
+ *
+ * The input is read once, one chunk at a time: while the threads count the
+ * values of a chunk, a second thread reads the next one into another buffer.
+ * The output is then generated from the histogram alone, again filling a
+ * chunk while the previous one is being written. Only two chunks and the
+ * histogram are in memory at any time, so the size of the file is only
+ * limited by the range of its values (at most STREAM_MAX_RANGE).
+ */
+long long stream_sort_file(const char *input, const char *output,
+                           long long chunk_bytes, int nthreads);
+
+
+#endif /* STREAM_SORT_H */
@@ -0,0 +1,197 @@
+/**
+ * @file tuning.h
+ * @brief This file contains the functions needed to choose where the threads
+ *        run, how the loops are scheduled and how many threads to use.
+ * @author Marco Plaitano
+ * @date 13 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TUNING_H
+#define TUNING_H
+
+#include <stdbool.h>
+
+
+/**
+ * @brief Where the threads of the sort are pinned, as with OMP_PROC_BIND.
+ *
+ * - AFFINITY_NONE:    every thread may run on any CPU of the process.
+ * - AFFINITY_COMPACT: thread t runs on the t-th CPU of the process, so
+ *                     consecutive threads share caches (OMP_PROC_BIND=close).
+ * - AFFINITY_SPREAD:  the threads are spread evenly over the CPUs, so they
+ *                     share as little as possible (OMP_PROC_BIND=spread).
+ */
+typedef enum {
+    AFFINITY_NONE,
+    AFFINITY_COMPACT,
+    AFFINITY_SPREAD
+} thread_affinity;
+
+
+/**
+ * @brief Loops of the sort whose schedule can be chosen.
+ *
+ * - LOOP_ZERO_FILL: clearing the shared histogram (atomic mode).
+ * - LOOP_HISTOGRAM: counting into the shared histogram (atomic mode); with
+ *                   private histograms every thread counts its own block.
+ * - LOOP_MERGE:     summing the private histograms, by blocks of
+ *                   MERGE_BLOCK buckets.
+ * - LOOP_SCATTER:   writing the sorted array, by slices; with a schedule
+ *                   other than static, the array is split into
+ *                   SCATTER_SLICES slices per thread so that it can balance
+ *                   them.
+ */
+typedef enum {
+    LOOP_ZERO_FILL,
+    LOOP_HISTOGRAM,
+    LOOP_MERGE,
+    LOOP_SCATTER,
+    NUM_LOOPS
+} sort_loop;
+
+
+/** @brief Kind of schedule of a loop, as in the OpenMP `schedule` clause. */
+typedef enum {
+    SCHEDULE_STATIC,
+    SCHEDULE_DYNAMIC,
+    SCHEDULE_GUIDED
+} schedule_kind;
+
+
+/** @brief Number of buckets merged by an iteration of LOOP_MERGE. */
+#define MERGE_BLOCK 1024
+
+/** @brief Slices per thread of LOOP_SCATTER with a non-static schedule. */
+#define SCATTER_SLICES 8
+
+
+/**
+ * @brief Pin the threads of the next parallel regions.
+ * @param policy:   The policy.
+ * @param nthreads: Number of threads the sort is going to use.
+ *
+ * Every thread of a team of `nthreads` pins itself to its CPU; as OpenMP
+ * keeps the same threads from one parallel region to the next, they stay
+ * there for the following sorts. AFFINITY_NONE lets them run anywhere again.
+ * Without OpenMP, or outside Linux, it does nothing.
+ */
+void tuning_set_affinity(thread_affinity policy, int nthreads);
+
+/**
+ * @brief Choose the schedule of a loop of the sort.
+ * @param loop:  The loop.
+ * @param kind:  Kind of schedule.
+ * @param chunk: Number of iterations given to a thread at once; 0 for the
+ *               default of `kind` (for SCHEDULE_STATIC, an equal block per
+ *               thread).
+ *
+ * Every loop defaults to SCHEDULE_STATIC with chunk 0.
+ */
+void tuning_set_schedule(sort_loop loop, schedule_kind kind, long long chunk);
+
+/**
+ * @brief Return `true` if the schedule of the loop is not the default one.
+ * @param loop: The loop.
+ */
+bool tuning_custom_schedule(sort_loop loop);
+
+/**
+ * @brief Schedule of the `schedule(runtime)` loops of a thread, as replaced by
+ *        tuning_apply_schedule().
+ */
+typedef struct {
+    /** Kind, as an omp_sched_t. */
+    int kind;
+    /** Chunk size. */
+    int chunk;
+} saved_schedule;
+
+/**
+ * @brief Make the schedule of a loop the one of the next `schedule(runtime)`
+ *        loops started by the calling thread.
+ * @param loop: The loop.
+ * @return The schedule replaced, to be given back to tuning_restore_schedule().
+ *
+ * It is meant to be called right before the loop: by all the threads of the
+ * team inside the parallel region, whose schedules end with it, or by the
+ * thread starting the region, which has to restore its own afterwards so
+ * that the loops of the caller are not affected.
+ */
+saved_schedule tuning_apply_schedule(sort_loop loop);
+
+/**
+ * @brief Give back to the calling thread the schedule it had before
+ *        tuning_apply_schedule().
+ * @param saved: The schedule returned by tuning_apply_schedule().
+ */
+void tuning_restore_schedule(saved_schedule saved);
+
+/**
+ * @brief Load the thread counts found by previous runs of the autotuner.
+ * @param path: Path to the profile file; it does not need to exist.
+ *
+ * The entries are added to the ones already known.
+ */
+void tuning_load_profile(const char *path);
+
+/**
+ * @brief Write all the thread counts found by the autotuner so far.
+ * @param path: Path to the profile file; it is overwritten.
+ */
+void tuning_save_profile(const char *path);
+
+/**
+ * @brief Return the number of threads that sorts fastest an array.
+ * @param size:        Number of elements of the array.
+ * @param min:         Minimum value of the array.
+ * @param max:         Maximum value of the array.
+ * @param max_threads: Maximum number of threads to use.
+ * @return A number of threads between 1 and `max_threads`.
+ *
+ * The result is looked up among the known entries, by powers of 2 of the
+ * size and of the range; if there is none, every power of 2 of threads up to
+ * `max_threads` (and `max_threads` itself) sorts a random array of the same
+ * size and range, and the fastest is added to the entries. Small arrays of
+ * a wide range are often sorted faster by fewer threads than available, as
+ * every thread has to clear and merge a whole histogram.
+ */
+int tuning_best_threads(long long size, int min, int max, int max_threads);
+
+/**
+ * @brief Return the affinity policy named `name`, exiting the program if
+ *        there is no such policy.
+ * @param name: "none", "compact" or "spread".
+ */
+thread_affinity affinity_parse(const char *name);
+
+/**
+ * @brief Parse a schedule given as "loop=kind[,chunk]" (e.g.
+ *        "merge=dynamic,4") and apply it, exiting the program if it is not
+ *        valid.
+ * @param spec: The schedule; loop is one of "zero_fill", "histogram",
+ *              "merge", "scatter" and kind one of "static", "dynamic",
+ *              "guided".
+ */
+void schedule_parse(const char *spec);
+
+
+#endif /* TUNING_H */
@@ -27,8 +27,8 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <stdint.h>
 #include <stdio.h>
-#include <sys/time.h>
 
 /** @brief Minimum value accepted in the array. */
 #define RANGE_MIN 0
@@ -36,35 +36,96 @@
 /** @brief Maximum value accepted in the array. */
 #define RANGE_MAX 100000
 
+/** @brief Size, in bytes, of a transparent huge page. */
+#define HUGE_PAGE_SIZE (2LL << 20)
+
+/**
+ * @brief First element of block `b` when `size` elements are split into
+ *        `nblocks` contiguous blocks.
+ *
+ * Every parallel loop over an array (initialization, histogram, write-back)
+ * splits it with this same static partition, so that thread `t` always works
+ * on the memory it touched first and, on NUMA hosts, on its own node.
+ * Block `b` covers [BLOCK_BEGIN(size, b, n), BLOCK_BEGIN(size, b + 1, n)).
+ */
+#define BLOCK_BEGIN(size, b, nblocks) \
+    ((long long)(size) * (b) / (nblocks))
+
+/**
+ * @brief Compile the function that follows once for AVX-512, once for AVX2
+ *        and once for the baseline x86-64, and pick one at load time.
+ *
+ * Only meant for leaf functions the compiler can vectorize: the bodies of the
+ * OpenMP regions are outlined into other functions, which are not cloned.
+ * It expands to nothing when the build already targets a vector extension
+ * (e.g. `make native`), and with compilers or architectures lacking the
+ * `target_clones` attribute.
+ */
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__AVX2__) && \
+    defined(__has_attribute)
+    #if __has_attribute(target_clones)
+        #define ISA_CLONES \
+            __attribute__((target_clones("avx512f", "avx2", "default")))
+    #endif
+#endif
+#ifndef ISA_CLONES
+    #define ISA_CLONES
+#endif
+
+
+/**
+ * @brief How the pages of an array are placed on the NUMA nodes.
+ *
+ * - ALLOC_DEFAULT:     plain malloc(); pages land wherever they are touched.
+ * - ALLOC_FIRST_TOUCH: every thread touches its own BLOCK_BEGIN() block, so
+ *                      each page starts on the node of the thread using it.
+ * - ALLOC_INTERLEAVE:  pages are spread round-robin over all the nodes
+ *                      (requires libnuma, falls back to ALLOC_FIRST_TOUCH).
+ */
+typedef enum {
+    ALLOC_DEFAULT,
+    ALLOC_FIRST_TOUCH,
+    ALLOC_INTERLEAVE
+} alloc_policy;
+
 
 /**
  * @brief Start measuring the passing of time.
  * @param var: Name of the `double` variable in which to save measurements.
  *
- * The measurement is taken on Wall-Clock time by calling the gettimeofday()
- * function.
+ * The measurement is taken on a monotonic clock by calling monotonic_time(),
+ * so it is not affected by adjustments of the system time.
  */
 #define START_TIME(var) \
-    struct timeval begin_##var, end_##var; \
-    gettimeofday(&begin_##var, 0);
+    double begin_##var = monotonic_time();
 
 /**
  * @brief Stop measuring the passing of time and save the result in `var`.
  * @param var: Name of the variable in which to save measurements.
  *
- * The measurement is taken on Wall-Clock time by calling the gettimeofday()
- * function. The function is supposed to have already been called before, via
- * the START_TIME macro, on the same variable.
- * `var` will contain the difference (in seconds and microseconds) of the values
- * gotten by the two calls to gettimeofday().
+ * The START_TIME macro is supposed to have already been used before on the
+ * same variable. `var` will contain the seconds elapsed between the two, with
+ * nanosecond resolution.
  */
 #define END_TIME(var) \
-    gettimeofday(&end_##var, 0); \
-    long seconds_##var = end_##var.tv_sec - begin_##var.tv_sec; \
-    long microseconds_##var = end_##var.tv_usec - begin_##var.tv_usec; \
-    var = seconds_##var + microseconds_##var * 1e-6;
+    var = monotonic_time() - begin_##var;
 
 
+/**
+ * @brief Return the current time of the monotonic clock, in seconds.
+ */
+double monotonic_time(void);
+
+/**
+ * @brief Return the number of threads a `num_threads(nthreads)` region can
+ *        be given at most, to size the memory its threads index by id.
+ * @param nthreads: Number of threads requested; 0 (or less) asks for the
+ *                  default team.
+ * @return `nthreads`, or the size of the default team if it is not positive;
+ *         1 when OpenMP parallelization is disabled.
+ */
+int team_size(int nthreads);
+
 /**
  * @brief Allocate `size` bytes of memory and check that the operation is
  *        successful.
@@ -73,6 +134,58 @@
  */
 void *safe_alloc(long long size);
 
+/**
+ * @brief Allocate `size` bytes of memory starting at an address multiple of
+ *        `alignment` and check that the operation is successful.
+ * @param alignment: Alignment, in bytes; must be a power of 2.
+ * @param size:      Number of bytes to allocate.
+ * @return Pointer to the memory allocated; to be released with free().
+ */
+void *safe_aligned_alloc(long long alignment, long long size);
+
+/**
+ * @brief Allocate `size` bytes of memory backed, if the kernel allows it, by
+ *        transparent huge pages, and check that the operation is successful.
+ * @param size: Number of bytes to allocate; rounded up to HUGE_PAGE_SIZE.
+ * @return Pointer to the memory allocated, aligned to HUGE_PAGE_SIZE; to be
+ *         released with free().
+ *
+ * Fewer pages mean fewer TLB misses when the whole area is streamed through,
+ * as the data and count arrays of the sort are.
+ */
+void *safe_alloc_huge(long long size);
+
+/**
+ * @brief Allocate `size` bytes of memory placed according to `policy` and
+ *        check that the operation is successful.
+ * @param size:     Number of bytes to allocate.
+ * @param policy:   Placement of the pages on the NUMA nodes.
+ * @param nthreads: Number of threads that will work on the memory; with
+ *                  ALLOC_FIRST_TOUCH it must match the one given to the
+ *                  functions using the array.
+ * @return Pointer to the memory allocated; to be released with
+ *         safe_free_policy().
+ *
+ * Except for ALLOC_DEFAULT, areas of at least HUGE_PAGE_SIZE bytes are backed
+ * by transparent huge pages when the kernel allows it.
+ */
+void *safe_alloc_policy(long long size, alloc_policy policy, int nthreads);
+
+/**
+ * @brief Release memory obtained from safe_alloc_policy().
+ * @param ptr:    Pointer to the memory.
+ * @param size:   Number of bytes given to safe_alloc_policy().
+ * @param policy: Policy given to safe_alloc_policy().
+ */
+void safe_free_policy(void *ptr, long long size, alloc_policy policy);
+
+/**
+ * @brief Parse the name of an allocation policy.
+ * @param name: One of "default", "first-touch", "interleave".
+ * @return The policy; the program exits if the name is not recognized.
+ */
+alloc_policy alloc_policy_parse(const char *name);
+
 /**
  * @brief Open a file in the given mode.
  * @param path: Path to the file to open.
@@ -81,17 +194,155 @@ void *safe_alloc(long long size);
  */
 FILE *file_open(const char *path, const char *mode);
 
+/**
+ * @brief How file_map() maps a file.
+ *
+ * - FILE_MAP_READ:   read-only; the file must exist.
+ * - FILE_MAP_UPDATE: read-write, changes written back to the file; the file
+ *                    must exist.
+ * - FILE_MAP_CREATE: read-write, on a file created (or truncated) with the
+ *                    size given.
+ */
+typedef enum {
+    FILE_MAP_READ,
+    FILE_MAP_UPDATE,
+    FILE_MAP_CREATE
+} file_map_mode;
+
+/**
+ * @brief Map a file in memory.
+ * @param path:  Path to the file.
+ * @param bytes: Size of the file, in bytes: input with FILE_MAP_CREATE,
+ *               output otherwise.
+ * @param mode:  How to map the file.
+ * @return Pointer to the contents of the file, or NULL if it is empty; to be
+ *         released with file_unmap().
+ *
+ * Existing files are read ahead as they are mapped (MAP_POPULATE), and all
+ * the mappings are advised to be accessed sequentially, as every thread of
+ * the sort scans its own block from start to end.
+ */
+void *file_map(const char *path, long long *bytes, file_map_mode mode);
+
+/**
+ * @brief Release a mapping obtained from file_map().
+ * @param ptr:   Pointer to the contents of the file.
+ * @param bytes: Size of the file, in bytes.
+ */
+void file_unmap(void *ptr, long long bytes);
+
 /**
  * @brief Fill the array with random integers.
  * @param array:    The array.
  * @param size:     Number of elements to generate.
  * @param min:      Minimum value accepted in the array.
  * @param max:      Maximum value accepted in the array.
+ * @param seed:     Seed of the generator.
  * @param nthreads: Number of threads to use when OpenMP parallelization is
  *                  enabled.
+ *
+ * Element `i` only depends on `seed` and `i` (it is the i-th output of the
+ * SplitMix64 generator), so the same seed gives the same array whatever the
+ * number of threads, and the values are uniform in [min; max].
  */
 void array_init_random(int *array, long long size, int min, int max,
-                       int nthreads);
+                       uint64_t seed, int nthreads);
+
+/**
+ * @brief Shape of the values generated by array_init_distribution().
+ *
+ * - DIST_UNIFORM: every value of [min; max] equally likely.
+ * - DIST_ZIPF:    value min + k - 1 with probability roughly proportional to
+ *                 1 / k (Zipf's law with exponent 1).
+ * - DIST_NORMAL:  normal around the middle of the range, with standard
+ *                 deviation 1/8 of it; clamped to [min; max].
+ * - DIST_EQUAL:   every element equal to min.
+ * - DIST_SORTED:  values spread evenly on [min; max], in ascending order.
+ * - DIST_REVERSE: like DIST_SORTED, in descending order.
+ * - DIST_FEW:     FEW_DISTINCT values evenly spaced on [min; max], equally
+ *                 likely.
+ */
+typedef enum {
+    DIST_UNIFORM,
+    DIST_ZIPF,
+    DIST_NORMAL,
+    DIST_EQUAL,
+    DIST_SORTED,
+    DIST_REVERSE,
+    DIST_FEW
+} distribution;
+
+/** @brief Seed of the hash used by array_checksum(). */
+#define CHECKSUM_SEED 0x5EED5EED5EED5EEDULL
+
+/** @brief Number of distinct values generated with DIST_FEW. */
+#define FEW_DISTINCT 16
+
+/**
+ * @brief Fill the array with integers following the given distribution.
+ * @param array:    The array.
+ * @param size:     Number of elements to generate.
+ * @param min:      Minimum value accepted in the array.
+ * @param max:      Maximum value accepted in the array.
+ * @param dist:     The distribution.
+ * @param seed:     Seed of the generator.
+ * @param nthreads: Number of threads to use when OpenMP parallelization is
+ *                  enabled.
+ *
+ * As for array_init_random(), which it is equivalent to with DIST_UNIFORM,
+ * the array only depends on the seed and not on the number of threads.
+ */
+void array_init_distribution(int *array, long long size, int min, int max,
+                             distribution dist, uint64_t seed, int nthreads);
+
+/**
+ * @brief Fill the array with a slice of the array array_init_distribution()
+ *        would generate.
+ * @param array:    The array.
+ * @param first:    Position of the slice in the whole array.
+ * @param size:     Number of elements of the slice.
+ * @param total:    Number of elements of the whole array.
+ *
+ * All the other parameters are the same as array_init_distribution(); the
+ * processes of a distributed sort can so generate the same data as a single
+ * one, each its own part.
+ */
+void array_init_slice(int *array, long long first, long long size,
+                      long long total, int min, int max, distribution dist,
+                      uint64_t seed, int nthreads);
+
+/**
+ * @brief Parse the name of a distribution.
+ * @param name: One of "uniform", "zipf", "normal", "equal", "sorted",
+ *              "reverse", "few".
+ * @return The distribution; the program exits if the name is not recognized.
+ */
+distribution distribution_parse(const char *name);
+
+/**
+ * @brief Find the first element smaller than the one before it.
+ * @param array:    The array.
+ * @param size:     Number of elements stored in the array.
+ * @param nthreads: Number of threads to use when OpenMP parallelization is
+ *                  enabled.
+ * @return Position of the element, or -1 if the array is sorted.
+ */
+long long array_find_unsorted(const int *array, long long size,
+                              int nthreads);
+
+/**
+ * @brief Compute a checksum of the values of the array that does not depend
+ *        on their order.
+ * @param array:    The array.
+ * @param size:     Number of elements stored in the array.
+ * @param nthreads: Number of threads to use when OpenMP parallelization is
+ *                  enabled.
+ * @return The sum, modulo 2^64, of a hash of every element.
+ *
+ * An array and its sorted copy have the same checksum; a sort that loses,
+ * duplicates or alters some values very likely changes it.
+ */
+uint64_t array_checksum(const int *array, long long size, int nthreads);
 
 /**
  * @brief Print the contents of the given array.
@@ -0,0 +1,181 @@
+/**
+ * @file main.c
+ * @brief Main file of the distributed program, used to generate and sort an
+ *        array split among MPI processes using Counting Sort Algorithm.
+ * @author Marco Plaitano
+ * @date 13 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "counting_sort.h"
+#include "mpi_sort.h"
+#include "util.h"
+
+
+/**
+ * @brief Check that the array split among the processes is sorted.
+ * @param array: The part of the array owned by the calling process.
+ * @param size:  Number of elements in the part.
+ * @param comm:  The communicator.
+ * @return `true` in every process if the whole array is sorted.
+ *
+ * Besides its own part, every process compares its first element with the
+ * last one of the closest non-empty part before it.
+ */
+static bool is_sorted(const int *array, long long size, MPI_Comm comm) {
+    int rank = 0, nranks = 0, last = 0, prev_last = 0;
+    int has = size > 0, prev_has = 0;
+    int ok = 1, all = 0;
+
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &nranks);
+
+    for (long long i = 1; i < size; i++)
+        if (array[i] < array[i - 1])
+            ok = 0;
+
+    /* Pass the last element of the non-empty parts down to the next ranks. */
+    for (int r = 1; r < nranks; r++) {
+        if (rank == r - 1) {
+            last = has ? array[size - 1] : prev_last;
+            int any = has || prev_has;
+            MPI_Send(&any, 1, MPI_INT, r, 0, comm);
+            MPI_Send(&last, 1, MPI_INT, r, 1, comm);
+        }
+        else if (rank == r) {
+            MPI_Recv(&prev_has, 1, MPI_INT, r - 1, 0, comm, MPI_STATUS_IGNORE);
+            MPI_Recv(&prev_last, 1, MPI_INT, r - 1, 1, comm,
+                     MPI_STATUS_IGNORE);
+            if (has && prev_has && array[0] < prev_last)
+                ok = 0;
+        }
+    }
+
+    MPI_Allreduce(&ok, &all, 1, MPI_INT, MPI_MIN, comm);
+    return all;
+}
+
+
+/**
+ * @brief Return the sum of the whole array split among the processes, to
+ *        check that sorting it left the values unchanged.
+ * @param array: The part of the array owned by the calling process.
+ * @param size:  Number of elements in the part.
+ * @param comm:  The communicator.
+ */
+static long long array_sum(const int *array, long long size, MPI_Comm comm) {
+    long long sum = 0, total = 0;
+    for (long long i = 0; i < size; i++)
+        sum += array[i];
+    MPI_Allreduce(&sum, &total, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    return total;
+}
+
+
+int main(int argc, char **argv) {
+    int rank = 0, nranks = 0;
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+
+    uint64_t seed = 0;
+    distribution dist = DIST_UNIFORM;
+    int min = RANGE_MIN, max = RANGE_MAX;
+    bool verify = false;
+    int opt = 0;
+
+    while ((opt = getopt(argc, argv, "d:r:s:v")) != -1) {
+        if (opt == 'd')
+            dist = distribution_parse(optarg);
+        else if (opt == 'r') {
+            if (sscanf(optarg, "%d:%d", &min, &max) != 2 || min > max)
+                argc = 0;
+        }
+        else if (opt == 's')
+            seed = strtoull(optarg, NULL, 10);
+        else if (opt == 'v')
+            verify = true;
+        else
+            argc = 0;
+    }
+
+    if (argc - optind < 2) {
+        if (rank == 0)
+            fprintf(stderr, "usage: mpirun -n P mpi.out "
+                            "[-d uniform|zipf|normal|equal|sorted|reverse|few] "
+                            "[-r min:max] [-s seed] [-v] (int)array_size "
+                            "(int)num_threads\n");
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+
+    /* Every process owns one block of the whole array. */
+    const long long total = atoll(argv[optind]);
+    int num_threads = atoi(argv[optind + 1]);
+    long long first = BLOCK_BEGIN(total, rank, nranks);
+    long long size = BLOCK_BEGIN(total, rank + 1, nranks) - first;
+    int *array = (int *)safe_alloc_policy((size > 0 ? size : 1) * sizeof(int),
+                                          ALLOC_FIRST_TOUCH, num_threads);
+    double time_init = 0;
+    double time_sort = 0;
+
+    /* The same seed gives the same whole array as main.out. */
+    MPI_Barrier(MPI_COMM_WORLD);
+    time_init = MPI_Wtime();
+    array_init_slice(array, first, size, total, min, max, dist, seed,
+                     num_threads);
+    MPI_Barrier(MPI_COMM_WORLD);
+    time_init = MPI_Wtime() - time_init;
+
+    long long sum_before = verify ? array_sum(array, size, MPI_COMM_WORLD) : 0;
+    counting_sort_calibrate(num_threads);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    time_sort = MPI_Wtime();
+    mpi_counting_sort(array, size, MPI_COMM_WORLD, num_threads);
+    MPI_Barrier(MPI_COMM_WORLD);
+    time_sort = MPI_Wtime() - time_sort;
+
+    int status = EXIT_SUCCESS;
+    if (verify && (!is_sorted(array, size, MPI_COMM_WORLD) ||
+                   array_sum(array, size, MPI_COMM_WORLD) != sum_before)) {
+        if (rank == 0)
+            fprintf(stderr, "The array is not sorted.\n");
+        status = EXIT_FAILURE;
+    }
+
+    /* Same CSV line as main.out, printed once. */
+    if (rank == 0)
+        printf("%lld;%d;%.5f;%.5f;%.5f\n", total, num_threads, time_init,
+               time_sort, time_init + time_sort);
+
+    safe_free_policy(array, (size > 0 ? size : 1) * sizeof(int),
+                     ALLOC_FIRST_TOUCH);
+    MPI_Finalize();
+    return status;
+}
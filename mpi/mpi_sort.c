@@ -0,0 +1,93 @@
+/**
+ * @file mpi_sort.c
+ * @brief This file contains the functions needed to sort an array split among
+ *        MPI processes, using Counting Sort Algorithm.
+ * @author Marco Plaitano
+ * @date 13 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "mpi_sort.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "counting_sort.h"
+#include "histogram.h"
+#include "util.h"
+
+
+void mpi_counting_sort(int *array, long long size, MPI_Comm comm,
+                       int nthreads)
+{
+    int lmin = INT_MAX, lmax = INT_MIN, min = 0, max = 0;
+    long long i = 0, first = 0;
+
+    #pragma omp parallel for num_threads(nthreads) shared(array, size) \
+            private(i) reduction(min: lmin) reduction(max: lmax)
+    for (i = 0; i < size; i++) {
+        lmin = array[i] < lmin ? array[i] : lmin;
+        lmax = array[i] > lmax ? array[i] : lmax;
+    }
+    MPI_Allreduce(&lmin, &min, 1, MPI_INT, MPI_MIN, comm);
+    MPI_Allreduce(&lmax, &max, 1, MPI_INT, MPI_MAX, comm);
+    /* Nothing to sort in any process. */
+    if (min > max)
+        return;
+
+    long long count_size = (long long)max - min + 1;
+    if (count_size > MPI_SORT_MAX_RANGE) {
+        fprintf(stderr, "The range of the values [%d, %d] is too wide to "
+                        "sort the array with MPI.\n", min, max);
+        MPI_Abort(comm, EXIT_FAILURE);
+    }
+
+    /* 64-bit counters, since the total can exceed any single part. */
+    uint64_t *count = (uint64_t *)safe_alloc(sizeof(uint64_t) * count_size);
+    if (size > 0)
+        histogram_build(array, size, min, count, count_size, COUNT_64, NULL,
+                        NULL, HISTOGRAM_AUTO, nthreads);
+    else
+        for (i = 0; i < count_size; i++)
+            count[i] = 0;
+    MPI_Allreduce(MPI_IN_PLACE, count, count_size, MPI_UINT64_T, MPI_SUM,
+                  comm);
+
+    /* The slice of a process starts where the parts before it end. */
+    MPI_Exscan(&size, &first, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    int rank = 0;
+    MPI_Comm_rank(comm, &rank);
+    if (rank == 0)
+        first = 0;
+
+    long long *offset = (long long *)safe_alloc(sizeof(long long) *
+                                                (count_size + 1));
+    offset[0] = 0;
+    for (i = 0; i < count_size; i++)
+        offset[i + 1] = offset[i] + count[i];
+    counting_sort_fill(array, first, size, offset, count_size, min, nthreads);
+
+    free(offset);
+    free(count);
+}
@@ -33,7 +33,19 @@ from decimal import Decimal
 from pandas import read_csv
 from scipy.stats import norm
 from prettytable import PrettyTable
-from plots import plot_table
+from plots import plot_table, plot_phases, plot_bandwidth, \
+                  plot_strong_scaling, plot_weak_scaling
+
+
+# Phases measured by main.out -p, in the order of its output.
+PHASES = ["min_max", "zero_fill", "histogram", "merge", "scatter"]
+
+# Share of the STREAM peak above which a measure is bandwidth-bound.
+BANDWIDTH_BOUND = 0.6
+
+# Share of the sort spent out of the phases (waiting at barriers, starting
+# threads, allocating) above which a measure is sync-bound.
+SYNC_BOUND = 0.25
 
 
 
@@ -43,6 +55,30 @@ def my_round(num: float) -> float:
 
 
 
+def trimmed_mean(content, col: str) -> float:
+    """Calculate the mean of a column, leaving out the unlikely values."""
+    curr_data = content[col]
+    # Mean and Standard Deviation
+    # .norm generates a Normal Continuos Distribution
+    # .fit generates the MLE (Maximum Likelihood Estimation) for the
+    # given data by minimizing the negative log-likelihood function.
+    # The return values are location and scale parameters. For a normal
+    # distribution the location is its mean.
+    mean, std = norm.fit(curr_data)
+    # A constant column (e.g. counters that could not be read) has nothing to
+    # leave out.
+    if std == 0:
+        return mean
+    # Remove values that are too unlikely; in other words, only keep
+    # values inside the range  [mean - std, mean + std]
+    curr_data = content[(content[col] > (mean - std)) &
+                        (content[col] < (mean + std))][col]
+    if len(curr_data) == 0:
+        return 0.0
+    return norm.fit(curr_data)[0]
+
+
+
 def calculate_means(files: list) -> dict:
     """Calculate, for every file, the mean of every parameter."""
     # Dictionary in which keys are filenames and values are other dictionaries
@@ -57,23 +93,7 @@ def calculate_means(files: list) -> dict:
         content = read_csv(file, sep=';')
 
         for col in columns:
-            curr_data = content[col]
-            # Mean and Standard Deviation
-            # .norm generates a Normal Continuos Distribution
-            # .fit generates the MLE (Maximum Likelihood Estimation) for the
-            # given data by minimizing the negative log-likelihood function.
-            # The return values are location and scale parameters. For a normal
-            # distribution the location is its mean.
-            mean, std = norm.fit(curr_data)
-            # Remove values that are too unlikely; in other words, only keep
-            # values inside the range  [mean - std, mean + std]
-            curr_data = content[(content[col] > (mean - std)) &
-                                (content[col] < (mean + std))][col]
-            if len(curr_data) == 0:
-                mean = my_round(0.0)
-            else:
-                mean = norm.fit(curr_data)[0]
-            file_mean[col] = my_round(mean)
+            file_mean[col] = my_round(trimmed_mean(content, col))
         # Since elapsed time is the sum of init and sort times, it feels more
         # natural to keep this relationship instead of calculating a mean for
         # this parameter.
@@ -86,6 +106,73 @@ def calculate_means(files: list) -> dict:
 
 
 
+def calculate_phases(files: list) -> dict:
+    """Calculate, for every file, the mean of every per-thread phase column.
+
+    Files measured without main.out -p have no such columns and are left out.
+    Keys of the inner dictionaries are the column names, e.g.
+    't0_histogram_seconds'; they are kept apart from calculate_means() so that
+    the columns of the tables do not depend on the number of threads."""
+    all_phases = {}
+
+    for file in files:
+        content = read_csv(file, sep=';')
+        columns = [c for c in content.columns if c.startswith("t") and
+                   c.split("_")[0][1:].isdigit()]
+        if len(columns) == 0:
+            continue
+        all_phases[file] = {col: trimmed_mean(content, col) for col in columns}
+
+    return all_phases
+
+
+
+def summarize_phases(phases: dict, time_sort: float) -> dict:
+    """Summarize the per-thread measures of a file.
+
+    The result holds, for every phase, the seconds spent in it by the average
+    thread; 'sync', the seconds the average thread spent out of every phase
+    (waiting for the others, for the threads to start or for memory to be
+    allocated); 'bytes', the bytes moved from memory by all the threads, or
+    None without counters."""
+    nthreads = len([c for c in phases if c.endswith("_min_max_seconds")])
+    summary = {}
+
+    for phase in PHASES:
+        summary[phase] = sum(phases["t%d_%s_seconds" % (t, phase)]
+                             for t in range(nthreads)) / nthreads
+    summary["sync"] = max(time_sort - sum(summary[p] for p in PHASES), 0.0)
+
+    moved = [phases["t%d_%s_bytes" % (t, phase)]
+             for t in range(nthreads) for phase in PHASES]
+    summary["bytes"] = sum(moved) if min(moved) >= 0 else None
+
+    return summary
+
+
+
+def read_peaks(directory: str) -> dict:
+    """Read the STREAM Triad bandwidth (GB/s) of every number of threads.
+
+    The file is written by measures.sh with bench.out -b; without it the
+    bandwidth achieved is reported, but not compared with any peak."""
+    file = path.join(directory, "stream_peak.csv")
+    if not path.isfile(file):
+        print("No STREAM measures found: the peak bandwidth is unknown.")
+        return {}
+    content = read_csv(file, sep=';')
+    return dict(zip(content["threads"], content["triad"]))
+
+
+
+def peak_for(peaks: dict, num_threads: int) -> float:
+    """Return the peak bandwidth with the closest number of threads measured
+    (not more than the ones given), or 0 if unknown."""
+    measured = [t for t in peaks if t <= max(num_threads, 1)]
+    return peaks[max(measured)] if len(measured) > 0 else 0.0
+
+
+
 def parse_file_name(filename: str) -> tuple:
     """Get measure info (is_serial, size, n_threads, opt_lvl) from file name.
 
@@ -147,21 +234,27 @@ def create_row(file: str, is_serial: bool, size: int, num_threads: int,
 
 
 
-def make_table(root_dir: str, files: list, means: dict) -> None:
+def make_table(root_dir: str, files: list, means: dict, phases: dict,
+               peaks: dict) -> None:
     """Create a table storing, for every type of test, the mean of the results.
 
     Each table allows a comparison between every parallel measure, the
     correspondent serial version (with same optimization), and the default case:
     serial program compiled with -O0 flag.
     A new table will be created when either the problem's SIZE or the LEVEL OF
-    OPTIMIZATION changes.
+    OPTIMIZATION changes. The efficiency of every table is then plotted as
+    strong scaling curves, one per size, for every level of optimization.
     """
     fields = ["Type", "Size", "Threads", "Opt Lvl", "Time Init", "Time Sort",
               "Time Total", "Speedup", "Efficiency"]
     rows = []
+    # Rows of every table, by optimization level and size.
+    strong = {}
 
-    # All subdirectories in the output's root directory.
-    subdirs = sorted([d.path for d in scandir(root_dir) if d.is_dir()])
+    # All subdirectories in the output's root directory; the ones of weak
+    # scaling have tables of their own.
+    subdirs = sorted([d.path for d in scandir(root_dir) if d.is_dir() and
+                      not path.basename(d.path).startswith("weak")])
 
     for subdir in subdirs:
         # If current directory has optimization level 0 it surely contains only
@@ -215,17 +308,131 @@ def make_table(root_dir: str, files: list, means: dict) -> None:
         # Threads.
         plot_table(subdir, fields, rows)
 
+        make_bandwidth_table(subdir, curr_files, means, phases, peaks)
+        make_phases_table(subdir, curr_files, means, phases)
+
+        strong[(opt_lvl, size)] = list(rows)
         rows.clear()
 
+    plot_strong_scaling(root_dir, fields, strong)
+
+
+
+def make_bandwidth_table(directory: str, files: list, means: dict,
+                         phases: dict, peaks: dict) -> None:
+    """Create a table comparing the memory bandwidth achieved by every measure
+    with the STREAM peak of the host, and telling what bounds it.
+
+    The bytes moved are the ones counted by the hardware counters when
+    available; otherwise the sort is assumed to read the array once while
+    counting and to write it once, i.e. 8 bytes per element. A measure is
+    bandwidth-bound when it reaches BANDWIDTH_BOUND of the peak, else
+    sync-bound when its threads spend more than SYNC_BOUND of the time out
+    of the phases, else compute-bound."""
+    fields = ["Type", "Size", "Threads", "Opt Lvl", "Time Sort", "GB/s",
+              "Peak GB/s", "Peak Share", "Sync Share", "Bound"]
+    rows = []
+
+    for file in files:
+        is_serial, size, num_threads, opt_lvl = parse_file_name(file)
+        time_sort = float(means[file]["time_sort"])
+        if time_sort <= 0:
+            continue
+
+        summary = summarize_phases(phases[file], time_sort) \
+                  if file in phases else None
+        moved = summary["bytes"] if summary and summary["bytes"] else 8 * size
+        bandwidth = moved / time_sort * 1e-9
+        peak = peak_for(peaks, num_threads)
+        peak_share = bandwidth / peak if peak > 0 else None
+        sync_share = summary["sync"] / time_sort if summary else None
+
+        if peak_share is not None and peak_share >= BANDWIDTH_BOUND:
+            bound = "bandwidth"
+        elif sync_share is not None and sync_share >= SYNC_BOUND:
+            bound = "sync"
+        elif peak_share is not None and sync_share is not None:
+            bound = "compute"
+        else:
+            bound = "-"
+
+        rows.append(["Serial" if is_serial else "Parallel", size,
+                     num_threads, opt_lvl, time_sort, my_round(bandwidth),
+                     my_round(peak) if peak > 0 else "-",
+                     my_round(peak_share) if peak_share is not None else "-",
+                     my_round(sync_share) if sync_share is not None else "-",
+                     bound])
+
+    write_table(fields, rows, directory, "table_bandwidth")
+    plot_bandwidth(directory, fields, rows)
+
+
+
+def make_phases_table(directory: str, files: list, means: dict,
+                      phases: dict) -> None:
+    """Create a table with the seconds the average thread spends in every
+    phase of the sort, and out of them ('Sync')."""
+    fields = ["Type", "Size", "Threads", "Opt Lvl", "Time Sort"] + \
+             [p.replace("_", " ").title() for p in PHASES] + ["Sync"]
+    rows = []
+
+    for file in files:
+        if file not in phases:
+            continue
+        is_serial, size, num_threads, opt_lvl = parse_file_name(file)
+        time_sort = float(means[file]["time_sort"])
+        summary = summarize_phases(phases[file], time_sort)
+        rows.append(["Serial" if is_serial else "Parallel", size,
+                     num_threads, opt_lvl, time_sort] +
+                    [my_round(summary[p]) for p in PHASES + ["sync"]])
+
+    if len(rows) == 0:
+        return
+    write_table(fields, rows, directory, "table_phases")
+    plot_phases(directory, fields, rows)
+
+
+
+def make_weak_tables(root_dir: str, files: list, means: dict) -> None:
+    """Create, for every level of optimization measured with a constant number
+    of elements per thread, a table and a plot of the weak scaling efficiency:
+    the sort time of the serial version over the one of every number of
+    threads."""
+    fields = ["Type", "Size", "Threads", "Opt Lvl", "Time Sort", "Efficiency"]
 
+    subdirs = sorted([d.path for d in scandir(root_dir) if d.is_dir() and
+                      path.basename(d.path).startswith("weak")])
 
-def write_table(fields: list, rows: list, directory: str) -> None:
-    """Write a table with fields and rows onto the given file."""
+    for subdir in subdirs:
+        curr_files = sorted([f for f in files if f.find(subdir + "/") >= 0])
+        rows = []
+        time_base = None
+
+        for file in curr_files:
+            is_serial, size, num_threads, opt_lvl = parse_file_name(file)
+            time_sort = float(means[file]["time_sort"])
+            # The list is sorted: the serial measure always comes first.
+            if time_base is None:
+                time_base = time_sort
+            efficiency = my_round(time_base / time_sort) if time_sort > 0 \
+                         else 0
+            rows.append(["Serial" if is_serial else "Parallel", size,
+                         num_threads, opt_lvl, time_sort, efficiency])
+
+        write_table(fields, rows, subdir)
+        plot_weak_scaling(subdir, fields, rows)
+
+
+
+def write_table(fields: list, rows: list, directory: str,
+                name: str = "table") -> None:
+    """Write a table with fields and rows onto the file 'name'.csv of the given
+    directory."""
     table = PrettyTable()
     table.field_names = fields
     table.add_rows(rows)
     # Write table in standard CSV format, separator is ','.
-    with open(directory + "/table.csv", "w", encoding="UTF-8") as file:
+    with open(directory + "/" + name + ".csv", "w", encoding="UTF-8") as file:
         file.write(table.get_csv_string())
 
 
@@ -244,7 +451,8 @@ def main() -> None:
     files = []
     for root, dirs, files_found in walk(directory):
         for file in files_found:
-            if file.endswith(".csv") and file.find("table") == -1:
+            if file.endswith(".csv") and file.find("table") == -1 and \
+               file != "stream_peak.csv":
                 files.append(path.join(root, file))
     files = sorted(files)
 
@@ -255,8 +463,12 @@ def main() -> None:
     print("Calculating means...")
     means = calculate_means(files)
 
+    phases = calculate_phases(files)
+    peaks = read_peaks(directory)
+
     print("Creating tables and plots...")
-    make_table(directory, files, means)
+    make_table(directory, files, means, phases, peaks)
+    make_weak_tables(directory, files, means)
 
 
 
@@ -40,9 +40,11 @@ DESCRIPTION
         - Array size
         - Compiling optimization level
         - Number of threads used.
-    Each combination is tried out multiple times; when all measures are done,
-    the 'evaluate.py' script is launched to estimate means and draw tables and
-    plots of the newly generated results.
+    Each combination is tried out multiple times, recording the time spent by
+    every thread in each phase of the sort; the memory bandwidth of the host is
+    then measured with the STREAM kernels of bench.out. When all measures are
+    done, the 'evaluate.py' script is launched to estimate means and draw
+    tables and plots of the newly generated results.
 
 OPTIONS
     -h, --help
@@ -55,6 +57,17 @@ OPTIONS
         Write all the output in the DIR directory of your choice instead of the
         default location './output/'.
 
+    --dist NAME
+        Generate the arrays with the NAME distribution: uniform (default),
+        zipf, normal, equal, sorted, reverse or few.
+
+    --range MIN:MAX
+        Generate values in the range [MIN; MAX] instead of the default one.
+
+    --weak N
+        Also measure weak scaling: every number of threads T sorts an array of
+        N * T elements (N for the serial version).
+
     --no-plot
         Do not run the Python script to create the plots and tables." | more -d
 }
@@ -94,11 +107,27 @@ function compile {
 }
 
 
+# Print the columns of the CSV file, phases of every thread included (see
+# profile_print() in src/profile.c).
+# Argument $1 is the number of threads.
+function csv_header {
+    local phases=(min_max zero_fill histogram merge scatter)
+    local header="size;threads;time_init;time_sort;time_elapsed"
+    for (( t=0; t<($1 > 0 ? $1 : 1); t++ )); do
+        for phase in ${phases[@]}; do
+            header+=";t${t}_${phase}_seconds;t${t}_${phase}_cycles"
+            header+=";t${t}_${phase}_bytes"
+        done
+    done
+    echo "$header"
+}
+
+
 # Measure the execution time and save the results on a file.
+# Argument $1 is the number of threads.
 function measure_time {
     # First line in CSV file declares the columns format.
-    # echo "size;threads;time_init;time_sort;user;sys;real" > "$output_file"
-    echo "size;threads;time_init;time_sort;time_elapsed" > "$output_file"
+    csv_header $1 > "$output_file"
 
     # Show initial 0% progress.
     printf "\r[  0/%d   0%%]" $num_measures
@@ -150,6 +179,20 @@ while [[ -n $1 ]]; do
             output_dir="$2"
             [[ -z $output_dir ]] && raise_error "No output directory given."
             shift ; shift ;;
+        --dist)
+            distribution="$2"
+            [[ -z $distribution ]] && raise_error "No distribution given."
+            shift ; shift ;;
+        --range)
+            range="$2"
+            [[ ! $range =~ ^-?[0-9]+:-?[0-9]+$ ]] && \
+            raise_error "Not a valid range (MIN:MAX)."
+            shift ; shift ;;
+        --weak)
+            weak_size=$2
+            [[ ! $weak_size =~ ^[0-9]+$ ]] && \
+            raise_error "Not a valid number of elements per thread."
+            shift ; shift ;;
         --no-plot)
             no_plot=1
             shift ;;
@@ -175,6 +218,9 @@ exec_file="$project_dir/bin/main.out"
 # Default number of measures to perform for each combination of parameters.
 num_measures=${num_measures:="100"}
 
+# Default distribution of the values in the arrays.
+distribution=${distribution:="uniform"}
+
 # All levels of optimization to apply when compiling.
 optimization_levels=(0 1 2 3)
 
@@ -184,6 +230,9 @@ sizes=(10000 500000 2000000)
 # All number of threads to execute the program with.
 num_threads=(0 1 2 4 8 16)
 
+# Number of doubles of every array of the STREAM kernels (256MB each).
+stream_size=33554432
+
 # If not given, set directory in which to store measurements results.
 output_dir=${output_dir:="$project_dir/output"}
 # Create the directory if it does not exist yet.
@@ -224,7 +273,8 @@ for nthreads in ${num_threads[@]}; do
             printf "SIZE: %'d\n" $size
 
             # Command line arguments to pass to the C program.
-            exec_args=($size $nthreads)
+            exec_args=(-p -d "$distribution" $size $nthreads)
+            [[ -n $range ]] && exec_args=(-r "$range" "${exec_args[@]}")
 
             # Add leading zeros to the size and nthreads variables in order to
             # create files which can be correctly sorted.
@@ -239,12 +289,41 @@ for nthreads in ${num_threads[@]}; do
             # File in which to store current output.
             output_file="$curr_output_dir"/S$lzsize\_T$lznthreads\_O$opt_lvl.csv
 
-            measure_time
+            measure_time $nthreads
         done
+
+        # Weak scaling: the same number of elements for every thread.
+        if [[ -n $weak_size ]] && (( $opt_lvl > 0 )); then
+            size=$(( weak_size * (nthreads > 0 ? nthreads : 1) ))
+            printf "THREADS: $nthreads, OPTIMIZATION: $opt_lvl, "
+            printf "SIZE: %'d (weak scaling)\n" $size
+
+            exec_args=(-p -d "$distribution" $size $nthreads)
+            [[ -n $range ]] && exec_args=(-r "$range" "${exec_args[@]}")
+
+            lznthreads=$(add_leading_zeros $nthreads ${num_threads[-1]})
+            lzsize=$(add_leading_zeros $size $(( weak_size * num_threads[-1] )))
+            curr_output_dir="$output_dir"/weak_opt_$opt_lvl
+            mkdir -p "$curr_output_dir"
+            output_file="$curr_output_dir"/S$lzsize\_T$lznthreads\_O$opt_lvl.csv
+
+            measure_time $nthreads
+        fi
     done
 done
 
 
+# Peak memory bandwidth of the host, for every number of threads, to compare
+# the bandwidth achieved by the sort with.
+echo "Measuring the memory bandwidth..."
+make -C "$project_dir" clean > /dev/null 2>&1
+make -C "$project_dir" bench > /dev/null || raise_error
+stream_threads=$(printf "%s\n" ${num_threads[@]} | sed 's/^0$/1/' | sort -nu |
+                 paste -sd, -)
+"$project_dir"/bin/bench.out -b -n 10 $stream_size $stream_threads \
+    > "$output_dir"/stream_peak.csv || raise_error
+
+
 echo "All measures completed."
 
 [[ -z $no_plot ]] && python3 "$project_dir"/scripts/evaluate.py "$output_dir"
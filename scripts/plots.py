@@ -108,3 +108,111 @@ def get_axes_data(fields: list, rows: list, y_data: str) -> tuple:
             # "Efficiency").
             y.append(row[fields.index(y_data)])
     return x, y
+
+
+
+def plot_strong_scaling(directory: str, fields: list, tables: dict) -> None:
+    """Create, for every level of optimization, an image file plotting the
+    strong scaling Efficiency per Number of Threads of every array size.
+
+    'tables' holds the rows of the tables created by make_table(), by
+    (optimization level, size)."""
+    for opt_lvl in sorted(set(key[0] for key in tables)):
+        pyplot.figure(figsize=(7, 5))
+        for (lvl, size), rows in sorted(tables.items()):
+            if lvl != opt_lvl:
+                continue
+            x, y = get_axes_data(fields, rows, "Efficiency")
+            pyplot.plot(x[1:], y[1:], marker="o", label="Size %d" %size)
+
+        pyplot.grid(b=True, which='major', color='#bbbbbb', linestyle='-')
+        pyplot.axhline(1, color="blue", linestyle="--", label="Ideal")
+        pyplot.legend()
+        pyplot.xlabel("Number of Threads")
+        pyplot.ylabel("Strong Scaling Efficiency")
+        pyplot.title("Optimization -O%d" %opt_lvl)
+
+        pyplot.savefig(directory + "/plot_strong_scaling_O%d.jpg" %opt_lvl)
+        pyplot.close()
+
+
+
+def plot_weak_scaling(directory: str, fields: list, rows: list) -> None:
+    """Create an image file plotting weak scaling Efficiency per Number of
+    Threads."""
+    x, y = get_axes_data(fields, rows, "Efficiency")
+
+    pyplot.figure(figsize=(7, 5))
+    pyplot.plot(x[1:], [1] * len(x[1:]), color="blue", marker="x",
+                label="Efficiency Ideal")
+    pyplot.plot(x[1:], y[1:], color="green", marker="s",
+                label="Efficiency Experimental")
+
+    # Write precise Y value next to every point
+    for i in range(1, len(x)):
+        pyplot.text(x[i] - 0.25, y[i] + 0.05, "%.3f" %y[i])
+
+    # Plot configuration
+    pyplot.grid(b=True, which='major', color='#bbbbbb', linestyle='-')
+    pyplot.autoscale(enable=True, axis='x', tight=True)
+    pyplot.legend()
+    pyplot.xlabel("Number of Threads")
+    pyplot.ylabel("Weak Scaling Efficiency")
+
+    pyplot.savefig(directory + "/plot_weak_scaling.jpg")
+    pyplot.close()
+
+
+
+def plot_bandwidth(directory: str, fields: list, rows: list) -> None:
+    """Create an image file plotting the memory bandwidth achieved per Number
+    of Threads, against the STREAM peak of the host."""
+    x, y = get_axes_data(fields, rows, "GB/s")
+    _, peak = get_axes_data(fields, rows, "Peak GB/s")
+
+    pyplot.figure(figsize=(7, 5))
+    pyplot.bar([str(t) for t in x[1:]], y[1:], color="orange",
+               label="Sort")
+    if all(p != "-" for p in peak[1:]):
+        pyplot.plot([str(t) for t in x[1:]], peak[1:], color="red",
+                    marker="o", label="STREAM Triad")
+
+    # Write the bound of every measure on top of its bar
+    bounds = [row[fields.index("Bound")] for row in rows
+              if row[fields.index("Type")] == "Parallel"]
+    for i, bound in enumerate(bounds):
+        pyplot.text(i, y[i + 1], bound, ha="center", va="bottom")
+
+    pyplot.grid(b=True, which='major', axis='y', color='#bbbbbb',
+                linestyle='-')
+    pyplot.legend()
+    pyplot.xlabel("Number of Threads")
+    pyplot.ylabel("Bandwidth (GB/s)")
+
+    pyplot.savefig(directory + "/plot_bandwidth.jpg")
+    pyplot.close()
+
+
+
+def plot_phases(directory: str, fields: list, rows: list) -> None:
+    """Create an image file plotting, per Number of Threads, the seconds the
+    average thread spends in every phase of the sort as stacked bars."""
+    phases = fields[fields.index("Time Sort") + 1:]
+    labels = [("Serial" if row[fields.index("Type")] == "Serial"
+               else str(row[fields.index("Threads")])) for row in rows]
+    bottom = [0] * len(rows)
+
+    pyplot.figure(figsize=(7, 5))
+    for phase in phases:
+        heights = [row[fields.index(phase)] for row in rows]
+        pyplot.bar(labels, heights, bottom=bottom, label=phase)
+        bottom = [b + h for b, h in zip(bottom, heights)]
+
+    pyplot.grid(b=True, which='major', axis='y', color='#bbbbbb',
+                linestyle='-')
+    pyplot.legend()
+    pyplot.xlabel("Number of Threads")
+    pyplot.ylabel("Time (s)")
+
+    pyplot.savefig(directory + "/plot_phases.jpg")
+    pyplot.close()
@@ -53,7 +53,10 @@ OPTIONS
     -t T, --threads T
         Use T threads in parallel execution (default is 4).
         If '-s' option is given, execution will be serial, regardless of the
-        number of threads." | more -d
+        number of threads.
+
+    -f R, --fuzz R
+        Compare the sort against qsort() on R random cases (default is 200)." | more -d
 }
 
 
@@ -101,6 +104,10 @@ while [[ -n $1 ]]; do
             num_threads=$2
             [[ -z $num_threads ]] && raise_error "No number of threads given."
             shift ; shift ;;
+        -f | --fuzz)
+            fuzz_rounds=$2
+            [[ ! $fuzz_rounds =~ ^[0-9]+$ ]] && raise_error "Not a valid number of cases."
+            shift ; shift ;;
         *)
             raise_error "Argument '$1' not recognized." ;;
     esac
@@ -115,6 +122,7 @@ fi
 # Default values.
 target=${target:="test_parallel"}
 num_threads=${num_threads:="4"}
+fuzz_rounds=${fuzz_rounds:="200"}
 out_stream=${out_stream:="/dev/stdout"}
 
 # Determine root project directory based on whether this script has been
@@ -140,7 +148,8 @@ make -C "$project_dir" $target > /dev/null
 [[ $? != 0 ]] && raise_error
 
 # Run.
-[[ -f "$executable_file" ]] && "$executable_file" $num_threads > $out_stream
+[[ -f "$executable_file" ]] && "$executable_file" $num_threads "$(date +%s)" \
+                                $fuzz_rounds > $out_stream
 [[ $? == 0 ]] && echo "All tests passed."
 
 safe_exit 0
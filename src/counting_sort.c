@@ -28,12 +28,208 @@
 
 #ifdef _OPENMP
     #include <omp.h>
+#else
+    #define omp_get_thread_num() 0
+    #define omp_get_num_threads() 1
 #endif
 
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
+#if defined(__AVX2__) || defined(__AVX512F__)
+    #include <immintrin.h>
+#elif defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+#include "histogram.h"
+#include "profile.h"
+#include "radix_sort.h"
+#include "sparse_sort.h"
+#include "tuning.h"
 #include "util.h"
 
+/**
+ * @brief Number of elements looked at by counting_sort() to guess the range
+ *        of the values before building the histogram.
+ */
+#define SAMPLE_SIZE 1024
+
+/**
+ * @brief Maximum ratio between the range of the values and the size of the
+ *        array for counting_sort() to count the values directly; above it,
+ *        the array is sorted with radix_sort().
+ */
+#define RADIX_RANGE_RATIO 4
+
+/**
+ * @brief Minimum number of times every distinct value must occur, on average,
+ *        for sparse_sort() to be preferred over radix_sort().
+ */
+#define SPARSE_REPEAT_RATIO 8
+
+/**
+ * @brief Minimum ratio between the size of the array and the number of values
+ *        falling out of the dense band of the sample, for them to be split
+ *        from the array and sorted on their own instead of widening the range.
+ */
+#define OUTLIER_RATIO 64
+
+/**
+ * @brief Maximum size of the arrays sorted with a single parallel region;
+ *        larger ones go through the speculative histogram, which reads the
+ *        array once less.
+ */
+#define FUSED_MAX_SIZE (1 << 16)
+
+/**
+ * @brief Number of tasks, per thread, writing back an array split among the
+ *        threads by counting_sort_batch().
+ */
+#define BATCH_SLICES 4
+
+/**
+ * @brief Minimum size, in bytes, of the arrays written back with non-temporal
+ *        stores; smaller ones are likely to fit in the last level cache, where
+ *        regular stores are faster.
+ */
+#define STREAM_MIN_BYTES (1LL << 25)
+
+/*
+ * Vector used to fill the runs of the write-back, with regular or
+ * non-temporal stores: 32 bytes with AVX2, 16 bytes with SSE2 (always
+ * available on x86-64); on other targets SIMD_BYTES is left undefined and
+ * only scalar stores are used.
+ */
+#if defined(__AVX2__)
+    #define SIMD_BYTES 32
+    typedef __m256i simd_vector;
+    #define simd_load(ptr) _mm256_loadu_si256((const __m256i *)(ptr))
+    #define simd_store(ptr, v) _mm256_storeu_si256((__m256i *)(ptr), v)
+    #define simd_stream(ptr, v) _mm256_stream_si256((__m256i *)(ptr), v)
+    #define simd_set1_8(x) _mm256_set1_epi8(x)
+    #define simd_set1_16(x) _mm256_set1_epi16(x)
+    #define simd_set1_32(x) _mm256_set1_epi32(x)
+    #define simd_set1_64(x) _mm256_set1_epi64x(x)
+#elif defined(__SSE2__)
+    #define SIMD_BYTES 16
+    typedef __m128i simd_vector;
+    #define simd_load(ptr) _mm_loadu_si128((const __m128i *)(ptr))
+    #define simd_store(ptr, v) _mm_storeu_si128((__m128i *)(ptr), v)
+    #define simd_stream(ptr, v) _mm_stream_si128((__m128i *)(ptr), v)
+    #define simd_set1_8(x) _mm_set1_epi8(x)
+    #define simd_set1_16(x) _mm_set1_epi16(x)
+    #define simd_set1_32(x) _mm_set1_epi32(x)
+    #define simd_set1_64(x) _mm_set1_epi64x(x)
+#endif
+
+/** @brief Number of times every measure of the calibration is repeated. */
+#define CALIBRATION_ROUNDS 64
+
+
+/** @brief Largest number of threads with a serial threshold of its own. */
+#define CALIBRATION_MAX_THREADS 256
+
+
+/** @brief Costs measured by the calibration, and thresholds derived from them. */
+static struct {
+    /** Whether the costs have been measured or set; read atomically. */
+    int calibrated;
+    /** Seconds per comparison of insertion_sort(). */
+    double insertion_cost;
+    /** Seconds per element of serial_counting_sort(). */
+    double element_cost;
+    /** Seconds per bucket of serial_counting_sort(). */
+    double bucket_cost;
+    /**
+     * Size up to which sorting serially beats starting the threads, for every
+     * number of threads (the last item holds any larger team); -1 if not
+     * measured yet.
+     */
+    long long serial_threshold[CALIBRATION_MAX_THREADS + 1];
+} tuning;
+
+
+/** @brief Buffers and settings reused by every sort run with a context. */
+struct counting_sort_ctx {
+    /** Number of threads to use when OpenMP parallelization is enabled. */
+    int nthreads;
+    /** Histogram. */
+    void *count;
+    long long count_bytes;
+    /** Starting positions of the values (or digits, for Radix Sort). */
+    void *offset;
+    long long offset_bytes;
+    /** Private histograms of the threads. */
+    void *scratch;
+    long long scratch_bytes;
+    /** Auxiliary array for Radix Sort. */
+    void *buffer;
+    long long buffer_bytes;
+    /** How the last array was sorted. */
+    sort_decision decision;
+};
+
+
+/**
+ * @brief Find minimum and maximum values in a contiguous block of the array.
+ * @param array: First element of the block.
+ * @param size:  Number of elements in the block.
+ * @param min:   Minimum value (input and output); the values found in the block
+ *               are compared against the one it already holds.
+ * @param max:   Maximum value (input and output).
+ *
+ * When the compiler targets AVX2 or AVX-512 (e.g. with `-march=native`) the
+ * block is scanned 8 or 16 integers at a time; otherwise, the scalar loop is
+ * cloned for every vector extension (see ISA_CLONES) and left to the compiler
+ * to vectorize.
+ */
+ISA_CLONES
+static void min_max_block(const int *array, long long size, int *min, int *max)
+{
+    long long i = 0;
+    int lmin = *min, lmax = *max;
+
+#if defined(__AVX512F__)
+    __m512i vmin = _mm512_set1_epi32(lmin);
+    __m512i vmax = _mm512_set1_epi32(lmax);
+    for (; i + 16 <= size; i += 16) {
+        __m512i v = _mm512_loadu_si512((const void *)(array + i));
+        vmin = _mm512_min_epi32(vmin, v);
+        vmax = _mm512_max_epi32(vmax, v);
+    }
+    lmin = _mm512_reduce_min_epi32(vmin);
+    lmax = _mm512_reduce_max_epi32(vmax);
+#elif defined(__AVX2__)
+    __m256i vmin = _mm256_set1_epi32(lmin);
+    __m256i vmax = _mm256_set1_epi32(lmax);
+    for (; i + 8 <= size; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(array + i));
+        vmin = _mm256_min_epi32(vmin, v);
+        vmax = _mm256_max_epi32(vmax, v);
+    }
+    int lanes_min[8], lanes_max[8];
+    _mm256_storeu_si256((__m256i *)lanes_min, vmin);
+    _mm256_storeu_si256((__m256i *)lanes_max, vmax);
+    for (int l = 0; l < 8; l++) {
+        lmin = lanes_min[l] < lmin ? lanes_min[l] : lmin;
+        lmax = lanes_max[l] > lmax ? lanes_max[l] : lmax;
+    }
+#endif
+
+    /* Scalar loop: the whole block, or the tail left by the vector loop. */
+    for (; i < size; i++) {
+        lmin = array[i] < lmin ? array[i] : lmin;
+        lmax = array[i] > lmax ? array[i] : lmax;
+    }
+
+    *min = lmin;
+    *max = lmax;
+}
+
 
 /**
  * @brief Find minimum and maximum values in the array.
@@ -43,89 +239,1634 @@
  * @param max:      Maximum value (output).
  * @param nthreads: Number of threads to use when OpenMP parallelization is
  *                  enabled.
+ *
+ * Every thread scans its own block keeping a local min and max; the partial
+ * results are then combined by the OpenMP reduction, so no synchronization is
+ * needed inside the loop.
  */
 static void min_max(const int *array, long long size, int *min, int *max,
                     int nthreads)
 {
-    *min = array[0];
-    *max = array[0];
-    long long i = 0;
+    int lmin = array[0], lmax = array[0];
+    long long nblocks = team_size(nthreads);
+    long long t = 0;
+
+    #pragma omp parallel for num_threads(nthreads) default(shared) private(t) \
+            reduction(min: lmin) reduction(max: lmax)
+    for (t = 0; t < nblocks; t++) {
+        long long begin = BLOCK_BEGIN(size, t, nblocks);
+        long long end = BLOCK_BEGIN(size, t + 1, nblocks);
+        int bmin = array[begin < size ? begin : 0], bmax = bmin;
+        profile_begin(PHASE_MIN_MAX);
+        min_max_block(array + begin, end - begin, &bmin, &bmax);
+        profile_end(PHASE_MIN_MAX);
+        lmin = bmin < lmin ? bmin : lmin;
+        lmax = bmax > lmax ? bmax : lmax;
+    }
+
+    *min = lmin;
+    *max = lmax;
+}
+
+
+void counting_sort_offsets(const void *count, long long count_size,
+                           count_width width, long long *offset)
+{
+    long long sum = 0;
+
+    if (width == COUNT_64) {
+        const uint64_t *count64 = (const uint64_t *)count;
+        for (long long i = 0; i < count_size; i++) {
+            offset[i] = sum;
+            sum += count64[i];
+        }
+    }
+    else {
+        const uint32_t *count32 = (const uint32_t *)count;
+        for (long long i = 0; i < count_size; i++) {
+            offset[i] = sum;
+            sum += count32[i];
+        }
+    }
+    offset[count_size] = sum;
+}
+
+
+/**
+ * @brief Find the value whose run, in the sorted array, contains the given
+ *        position.
+ * @param offset:     Starting positions computed by counting_sort_offsets().
+ * @param count_size: Number of values in the range.
+ * @param pos:        Position in the sorted array.
+ * @return Index i (in the range [0; count_size - 1]) of the last value such
+ *         that offset[i] <= pos.
+ */
+static long long find_bucket(const long long *offset, long long count_size,
+                             long long pos)
+{
+    long long lo = 0, hi = count_size - 1;
+    while (lo < hi) {
+        long long mid = lo + (hi - lo + 1) / 2;
+        if (offset[mid] <= pos)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
+
+#define ELEM_T uint8_t
+#define SUFFIX u8
+#include "scatter_template.h"
+#undef ELEM_T
+#undef SUFFIX
+
+#define ELEM_T uint16_t
+#define SUFFIX u16
+#include "scatter_template.h"
+#undef ELEM_T
+#undef SUFFIX
+
+#define ELEM_T int32_t
+#define SUFFIX i32
+#include "scatter_template.h"
+#undef ELEM_T
+#undef SUFFIX
+
+#define ELEM_T int64_t
+#define SUFFIX i64
+#include "scatter_template.h"
+#undef ELEM_T
+#undef SUFFIX
+
 
+/**
+ * @brief Overwrite the array with the values counted in count[], in order.
+ * @param array:      The array.
+ * @param type:       Type of the elements of the array.
+ * @param size:       Number of elements stored in the array.
+ * @param count:      The array of occurrences.
+ * @param count_size: Number of items in count[].
+ * @param width:      Width of the counters in count[].
+ * @param min:        Value associated to count[0].
+ * @param offset:     Array of `count_size + 1` items to use for the starting
+ *                    positions of the values, or NULL to allocate it.
+ * @param nthreads:   Number of threads to use when OpenMP parallelization is
+ *                    enabled.
+ */
+static void write_back(void *array, elem_type type, long long size,
+                       const void *count, long long count_size,
+                       count_width width, long long min, long long *offset,
+                       int nthreads)
+{
     /*
-     * Critical regions have been introduced to avoid race conditions when
-     * either the min or the max have to be updated.
+     * The nested write-back loop carries a dependence on the output index;
+     * computing every value's starting position beforehand removes it and lets
+     * the threads fill disjoint slices of the array.
      */
-    #pragma omp parallel for num_threads(nthreads) default(shared) private(i)
-    for (i = 0; i < size; i++) {
-        if (array[i] < *min) {
-            #pragma omp critical
-            {
-                if (array[i] < *min)
-                    *min = array[i];
+    long long *given = offset;
+    if (offset == NULL)
+        offset = (long long *)safe_alloc(sizeof(long long) * (count_size + 1));
+    profile_begin(PHASE_SCATTER);
+    counting_sort_offsets(count, count_size, width, offset);
+    profile_end(PHASE_SCATTER);
+    switch (type) {
+    case ELEM_U8:
+        scatter_u8(array, size, offset, count_size, min, nthreads);
+        break;
+    case ELEM_U16:
+        scatter_u16(array, size, offset, count_size, min, nthreads);
+        break;
+    case ELEM_I32:
+        scatter_i32(array, size, offset, count_size, min, nthreads);
+        break;
+    case ELEM_I64:
+        scatter_i64(array, size, offset, count_size, min, nthreads);
+        break;
+    }
+    if (given == NULL)
+        free(offset);
+    return 1;
+}
+
+
+/**
+ * @brief Guess the range of the values from a sample of the array.
+ * @param array: The array.
+ * @param size:  Number of elements stored in the array.
+ * @param min:   Guessed minimum value (output).
+ * @param max:   Guessed maximum value (output).
+ *
+ * SAMPLE_SIZE elements, evenly spaced, are looked at; the range they span is
+ * then widened on both sides, since it is unlikely for the sample to contain
+ * the actual extremes.
+ */
+static void guess_range(const int *array, long long size, int *min, int *max) {
+    long long stride = size / SAMPLE_SIZE;
+    int smin = array[0], smax = array[0];
+
+    profile_begin(PHASE_MIN_MAX);
+    for (long long i = 0; i < SAMPLE_SIZE; i++) {
+        int item = array[i * stride];
+        smin = item < smin ? item : smin;
+        smax = item > smax ? item : smax;
+    }
+    profile_end(PHASE_MIN_MAX);
+
+    long long margin = ((long long)smax - smin) / 8 + 1;
+    long long lo = smin - margin, hi = smax + margin;
+    *min = lo < INT_MIN ? INT_MIN : lo;
+    *max = hi > INT_MAX ? INT_MAX : hi;
+}
+
+
+/** @brief Compare two `int`s; to be used with qsort(). */
+static int int_compare(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+
+/**
+ * @brief Guess the range holding most of the values from a sample of the
+ *        array, leaving out the few far from all the others.
+ * @param array: The array.
+ * @param size:  Number of elements stored in the array; at least SAMPLE_SIZE.
+ * @param min:   Guessed minimum value of the band (output).
+ * @param max:   Guessed maximum value of the band (output).
+ *
+ * The same sample of guess_range() is sorted, and the range between two of
+ * its quantiles is widened as in guess_range(). Only the smallest and the
+ * largest SAMPLE_SIZE / (2 * OUTLIER_RATIO) values are left out, so that a
+ * band with more than one value in OUTLIER_RATIO out of it is unlikely.
+ */
+static void guess_band(const int *array, long long size, int *min, int *max) {
+    long long stride = size / SAMPLE_SIZE;
+    long long trim = SAMPLE_SIZE / (2 * OUTLIER_RATIO);
+    int sample[SAMPLE_SIZE];
+
+    profile_begin(PHASE_MIN_MAX);
+    for (long long i = 0; i < SAMPLE_SIZE; i++)
+        sample[i] = array[i * stride];
+    qsort(sample, SAMPLE_SIZE, sizeof(int), int_compare);
+    profile_end(PHASE_MIN_MAX);
+
+    int smin = sample[trim], smax = sample[SAMPLE_SIZE - 1 - trim];
+    long long margin = ((long long)smax - smin) / 8 + 1;
+    long long lo = smin - margin, hi = smax + margin;
+    *min = lo < INT_MIN ? INT_MIN : lo;
+    *max = hi > INT_MAX ? INT_MAX : hi;
+}
+
+
+/**
+ * @brief Tell whether Radix Sort is preferable to Counting Sort.
+ * @param count_size: Number of values in the range of the array.
+ * @param size:       Number of elements stored in the array.
+ * @return `true` if the histogram would be much larger than the array itself.
+ */
+static bool use_radix(long long count_size, long long size) {
+    return count_size > RADIX_RANGE_RATIO * size;
+}
+
+
+/**
+ * @brief Make sure that a buffer of the context holds at least `bytes` bytes.
+ * @param buffer:   The buffer (input and output).
+ * @param capacity: Current size, in bytes, of the buffer (input and output).
+ * @param bytes:    Number of bytes needed.
+ * @param nthreads: Number of threads to use when OpenMP parallelization is
+ *                  enabled.
+ * @return The buffer.
+ *
+ * Buffers only ever grow. A new buffer is touched for the first time by the
+ * same threads, with the same static partition, that will then work on it, so
+ * that its pages are placed on their NUMA nodes.
+ */
+static void *ctx_reserve(void **buffer, long long *capacity, long long bytes,
+                         int nthreads)
+{
+    if (bytes <= *capacity)
+        return *buffer;
+
+    free(*buffer);
+    bytes = (bytes + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    char *ptr = (char *)(bytes >= HUGE_PAGE_SIZE
+                         ? safe_alloc_huge(bytes)
+                         : safe_aligned_alloc(CACHE_LINE_SIZE, bytes));
+
+    /* Same blocks as the array, so every thread's part stays on its node. */
+    #pragma omp parallel num_threads(nthreads) shared(ptr, bytes)
+    {
+        long long nt = omp_get_num_threads();
+        long long t = omp_get_thread_num();
+        long long begin = BLOCK_BEGIN(bytes, t, nt);
+        memset(ptr + begin, 0, BLOCK_BEGIN(bytes, t + 1, nt) - begin);
+    }
+
+    *buffer = ptr;
+    *capacity = bytes;
+    return ptr;
+}
+
+
+/**
+ * @brief Sort an array whose range is too wide for Counting Sort, choosing
+ *        between Radix Sort and hash-based counting.
+ * @param ctx:   The context.
+ * @param array: The array.
+ * @param size:  Number of elements stored in the array.
+ */
+static void sort_wide_range(counting_sort_ctx *ctx, int *array,
+                            long long size)
+{
+    int nthreads = ctx->nthreads;
+    long long distinct = estimate_distinct(array, size);
+
+    ctx->decision.min = ctx->decision.max = 0;
+    ctx->decision.outliers = 0;
+    ctx->decision.distinct = distinct;
+    if (distinct <= SPARSE_MAX_DISTINCT &&
+        distinct * SPARSE_REPEAT_RATIO <= size) {
+        ctx->decision.strategy = STRATEGY_SPARSE;
+        sparse_sort(array, size, nthreads);
+        return;
+    }
+    ctx->decision.strategy = STRATEGY_RADIX;
+
+    /* Resolved once: the workspace has one histogram per block of a pass. */
+    int nblocks = team_size(nthreads);
+    int *buffer = ctx_reserve(&ctx->buffer, &ctx->buffer_bytes,
+                              sizeof(int) * size, nblocks);
+    long long *offset = ctx_reserve(&ctx->offset, &ctx->offset_bytes,
+                                    sizeof(long long) * RADIX_BUCKETS *
+                                    nblocks, nblocks);
+    radix_sort_workspace(array, size, buffer, offset, nblocks);
+}
+
+
+/**
+ * @brief Count the values in the range [min; max] into the context's
+ *        histogram.
+ * @param ctx:        The context.
+ * @param array:      The array.
+ * @param size:       Number of elements stored in the array.
+ * @param min:        Minimum value to count.
+ * @param count_size: Number of values to count, starting from min.
+ * @param width:      Width of the counters.
+ * @param out_min:    See histogram_build().
+ * @param out_max:    See histogram_build().
+ * @return Number of elements found outside of the range.
+ */
+static long long ctx_histogram(counting_sort_ctx *ctx, const int *array,
+                               long long size, int min, long long count_size,
+                               count_width width, int *out_min, int *out_max)
+{
+    /* Resolved once, so that the scratch fits the team that will count. */
+    int nthreads = team_size(ctx->nthreads);
+    void *count = ctx_reserve(&ctx->count, &ctx->count_bytes,
+                              count_item_size(width) * count_size, nthreads);
+    void *scratch = ctx_reserve(&ctx->scratch, &ctx->scratch_bytes,
+                                histogram_scratch_size(count_size, width,
+                                                       nthreads),
+                                nthreads);
+    return histogram_build_scratch(array, size, min, count, count_size, width,
+                                   out_min, out_max, scratch, HISTOGRAM_AUTO,
+                                   nthreads);
+}
+
+
+/**
+ * @brief Overwrite the array with the values counted in the context's
+ *        histogram.
+ * @param ctx:        The context.
+ * @param array:      The array.
+ * @param size:       Number of elements stored in the array.
+ * @param min:        Value associated to the first counter.
+ * @param count_size: Number of counters.
+ * @param width:      Width of the counters.
+ */
+static void ctx_write_back(counting_sort_ctx *ctx, int *array, long long size,
+                           int min, long long count_size, count_width width)
+{
+    long long *offset = ctx_reserve(&ctx->offset, &ctx->offset_bytes,
+                                    sizeof(long long) * (count_size + 1),
+                                    ctx->nthreads);
+    write_back(array, ELEM_I32, size, ctx->count, count_size, width, min,
+               offset, ctx->nthreads);
+}
+
+
+/**
+ * @brief Same as counting_sort_range(), using the buffers of the context.
+ */
+static void sort_range_with_ctx(counting_sort_ctx *ctx, int *array,
+                                long long size, int min, int max)
+{
+    long long count_size = (long long)max - min + 1;
+    count_width width = histogram_width(size);
+
+    ctx_histogram(ctx, array, size, min, count_size, width, NULL, NULL);
+    ctx_write_back(ctx, array, size, min, count_size, width);
+}
+
+
+/**
+ * @brief Sort the given array using Insertion Sort Algorithm.
+ * @param array: The array.
+ * @param size:  Number of elements stored in the array.
+ */
+static void insertion_sort(int *array, long long size) {
+    for (long long i = 1; i < size; i++) {
+        int item = array[i];
+        long long j = i - 1;
+        for (; j >= 0 && array[j] > item; j--)
+            array[j + 1] = array[j];
+        array[j + 1] = item;
+    }
+}
+
+
+/**
+ * @brief Sort the given array using Counting Sort Algorithm, without starting
+ *        any thread.
+ * @param ctx:   The context providing the histogram.
+ * @param array: The array.
+ * @param size:  Number of elements stored in the array; less than 2^32.
+ * @param min:   Minimum value in the array.
+ * @param max:   Maximum value in the array.
+ */
+static void serial_counting_sort(counting_sort_ctx *ctx, int *array,
+                                 long long size, int min, int max)
+{
+    long long count_size = (long long)max - min + 1;
+    uint32_t *count = ctx_reserve(&ctx->count, &ctx->count_bytes,
+                                  sizeof(uint32_t) * count_size, 1);
+    long long i = 0, k = 0;
+
+    profile_begin(PHASE_ZERO_FILL);
+    for (i = 0; i < count_size; i++)
+        count[i] = 0;
+    profile_end(PHASE_ZERO_FILL);
+
+    profile_begin(PHASE_HISTOGRAM);
+    for (i = 0; i < size; i++)
+        count[array[i] - min] += 1;
+    profile_end(PHASE_HISTOGRAM);
+
+    profile_begin(PHASE_SCATTER);
+    for (i = 0; i < count_size; k += count[i], i++)
+        fill_run_i32(array, k, k + count[i], size, i + min);
+    profile_end(PHASE_SCATTER);
+}
+
+
+/**
+ * @brief Sort a small array, picking the cheapest serial algorithm according
+ *        to the calibrated costs.
+ * @param ctx:   The context.
+ * @param array: The array.
+ * @param size:  Number of elements stored in the array.
+ */
+static void serial_sort(counting_sort_ctx *ctx, int *array, long long size) {
+    int min = array[0], max = array[0];
+    profile_begin(PHASE_MIN_MAX);
+    min_max_block(array, size, &min, &max);
+    profile_end(PHASE_MIN_MAX);
+
+    long long count_size = (long long)max - min + 1;
+    bool wide = use_radix(count_size, size);
+    double insertion = tuning.insertion_cost * size * size / 4;
+    double counting = tuning.element_cost * size +
+                      tuning.bucket_cost * count_size;
+
+    /* A wide range is not counted: Radix Sort counts every digit instead. */
+    if (wide) {
+        long long passes = (sizeof(int) * 8 + RADIX_BITS - 1) / RADIX_BITS;
+        counting = passes * (tuning.element_cost * size +
+                             tuning.bucket_cost * RADIX_BUCKETS);
+    }
+
+    ctx->decision = (sort_decision){STRATEGY_DENSE, min, max, 0, -1};
+    if (insertion < counting) {
+        ctx->decision.strategy = STRATEGY_INSERTION;
+        insertion_sort(array, size);
+    }
+    else if (wide)
+        sort_wide_range(ctx, array, size);
+    else
+        serial_counting_sort(ctx, array, size, min, max);
+}
+
+
+/**
+ * @brief Sort the given array using Counting Sort Algorithm, within a single
+ *        parallel region.
+ * @param ctx:   The context.
+ * @param array: The array.
+ * @param size:  Number of elements stored in the array; less than 2^32.
+ * @return `false` if the range of the values is too wide for Counting Sort, in
+ *         which case the array is left untouched.
+ *
+ * Finding min and max, counting, merging and writing back are the same phases
+ * of counting_sort(), each shared among the threads of one parallel region,
+ * so that the threads are started only once.
+ */
+static bool fused_counting_sort(counting_sort_ctx *ctx, int *array,
+                                long long size)
+{
+    int nthreads = ctx->nthreads;
+    int min = array[0], max = array[0];
+    long long count_size = 0, stride = 0, i = 0;
+    bool wide = false, atomic = false;
+    uint32_t *count = NULL, *priv = NULL;
+    long long *offset = NULL;
+
+    #pragma omp parallel num_threads(nthreads) default(shared) private(i)
+    {
+        long long nt = omp_get_num_threads();
+        long long t = omp_get_thread_num();
+
+        /*
+         * Every loop over the array walks the thread's own BLOCK_BEGIN()
+         * block: with nt iterations a static schedule gives iteration t to
+         * thread t.
+         */
+        long long begin = BLOCK_BEGIN(size, t, nt);
+        long long end = BLOCK_BEGIN(size, t + 1, nt);
+
+        #pragma omp for schedule(static) reduction(min: min) \
+                reduction(max: max)
+        for (i = 0; i < nt; i++) {
+            profile_begin(PHASE_MIN_MAX);
+            min_max_block(array + begin, end - begin, &min, &max);
+            profile_end(PHASE_MIN_MAX);
+        }
+
+        #pragma omp single
+        {
+            count_size = (long long)max - min + 1;
+            wide = use_radix(count_size, size);
+            ctx->decision = (sort_decision){STRATEGY_DENSE, min, max, 0, -1};
+            if (!wide) {
+                long long per_line = CACHE_LINE_SIZE / sizeof(uint32_t);
+                stride = (count_size + per_line - 1) / per_line * per_line;
+                atomic = nt > 1 && count_size > ATOMIC_RATIO * (size / nt);
+                count = ctx_reserve(&ctx->count, &ctx->count_bytes,
+                                    sizeof(uint32_t) * count_size, 1);
+                offset = ctx_reserve(&ctx->offset, &ctx->offset_bytes,
+                                     sizeof(long long) * (count_size + 1), 1);
+                if (!atomic)
+                    priv = ctx_reserve(&ctx->scratch, &ctx->scratch_bytes,
+                                       sizeof(uint32_t) * stride * nt, 1);
+            }
+        }
+
+        if (!wide && atomic) {
+            profile_begin(PHASE_ZERO_FILL);
+            #pragma omp for schedule(static) nowait
+            for (i = 0; i < count_size; i++)
+                count[i] = 0;
+            profile_end(PHASE_ZERO_FILL);
+            #pragma omp barrier
+
+            profile_begin(PHASE_HISTOGRAM);
+            for (i = begin; i < end; i++) {
+                #pragma omp atomic update
+                count[array[i] - min] += 1;
             }
+            profile_end(PHASE_HISTOGRAM);
+            #pragma omp barrier
         }
-        else if (array[i] > *max) {
-            #pragma omp critical
+        else if (!wide) {
+            uint32_t *mine = priv + stride * t;
+            profile_begin(PHASE_ZERO_FILL);
+            for (long long b = 0; b < count_size; b++)
+                mine[b] = 0;
+            profile_end(PHASE_ZERO_FILL);
+
+            profile_begin(PHASE_HISTOGRAM);
+            for (i = begin; i < end; i++)
+                mine[array[i] - min] += 1;
+            profile_end(PHASE_HISTOGRAM);
+
+            /* Every thread merges a different range of buckets. */
+            #pragma omp barrier
+            profile_begin(PHASE_MERGE);
+            #pragma omp for schedule(static) nowait
+            for (i = 0; i < count_size; i++) {
+                uint32_t sum = 0;
+                for (long long s = 0; s < nt; s++)
+                    sum += priv[stride * s + i];
+                count[i] = sum;
+            }
+            profile_end(PHASE_MERGE);
+            #pragma omp barrier
+        }
+
+        if (!wide) {
+            #pragma omp single
             {
-                if (array[i] > *max)
-                    *max = array[i];
+                profile_begin(PHASE_SCATTER);
+                counting_sort_offsets(count, count_size, COUNT_32, offset);
+                profile_end(PHASE_SCATTER);
+            }
+
+            /* Every thread fills its own slice of the output. */
+            long long pos = begin;
+            profile_begin(PHASE_SCATTER);
+            if (pos < end) {
+                long long b = find_bucket(offset, count_size, pos);
+                for (; pos < end; b++) {
+                    long long run_end = offset[b + 1] < end ? offset[b + 1]
+                                                            : end;
+                    fill_run_i32(array, pos, run_end, end, b + min);
+                    pos = run_end;
+                }
             }
+            profile_end(PHASE_SCATTER);
         }
     }
+
+    return !wide;
+}
+
+
+/**
+ * @brief Sort an array whose values, but a few outliers, have been counted
+ *        into the context's histogram.
+ * @param ctx:        The context, holding the histogram of the dense band.
+ * @param array:      The array.
+ * @param size:       Number of elements stored in the array.
+ * @param min:        Value associated to the first counter.
+ * @param count_size: Number of counters.
+ * @param width:      Width of the counters.
+ * @param noutliers:  Number of elements out of the range of the histogram.
+ *
+ * The outliers are copied, in a single pass, to an array of their own, sorted
+ * with counting_sort() (which, given their range, likely picks Radix Sort)
+ * and copied back before and after the values of the band, at last written
+ * back from the histogram.
+ */
+static void sort_split_outliers(counting_sort_ctx *ctx, int *array,
+                                long long size, int min, long long count_size,
+                                count_width width, long long noutliers)
+{
+    int nthreads = ctx->nthreads;
+    long long nblocks = team_size(nthreads);
+    long long *found = (long long *)safe_alloc(sizeof(long long) * nblocks);
+    /* No block has more than all the outliers; pages never written cost none. */
+    int *outliers = (int *)safe_alloc(sizeof(int) * noutliers * nblocks);
+    long long nlow = 0, t = 0;
+
+    /* One block per iteration, whatever the size of the team running them. */
+    #pragma omp parallel for num_threads(nthreads) shared(found, outliers) \
+            private(t) reduction(+: nlow)
+    for (t = 0; t < nblocks; t++) {
+        int *mine = outliers + t * noutliers;
+        long long n = 0;
+
+        /* A scan of the array against the band, like the one of min_max(). */
+        profile_begin(PHASE_MIN_MAX);
+        for (long long i = BLOCK_BEGIN(size, t, nblocks);
+             i < BLOCK_BEGIN(size, t + 1, nblocks); i++)
+            if ((unsigned long long)((long long)array[i] - min) >=
+                (unsigned long long)count_size) {
+                mine[n++] = array[i];
+                nlow += array[i] < min;
+            }
+        found[t] = n;
+        profile_end(PHASE_MIN_MAX);
+    }
+
+    long long n = found[0];
+    for (t = 1; t < nblocks; t++) {
+        memmove(outliers + n, outliers + t * noutliers,
+                sizeof(int) * found[t]);
+        n += found[t];
+    }
+    free(found);
+
+    counting_sort(outliers, noutliers, nthreads);
+    ctx_write_back(ctx, array + nlow, size - noutliers, min, count_size,
+                   width);
+    memcpy(array, outliers, sizeof(int) * nlow);
+    memcpy(array + size - (noutliers - nlow), outliers + nlow,
+           sizeof(int) * (noutliers - nlow));
+    free(outliers);
+}
+
+
+/** @brief Item of tuning.serial_threshold of a team of `nthreads` threads. */
+static inline long long threshold_slot(int nthreads) {
+    long long n = team_size(nthreads);
+    return n < CALIBRATION_MAX_THREADS ? n : CALIBRATION_MAX_THREADS;
+}
+
+
+/** @brief Mark the serial threshold of every number of threads as unknown. */
+static void forget_thresholds(void) {
+    for (int n = 0; n <= CALIBRATION_MAX_THREADS; n++)
+        tuning.serial_threshold[n] = -1;
 }
 
 
 /**
- * @brief Return a positive integer representation of the item to use as index
- *        in an array.
- * @param item: The item to hash.
- * @param max:  Maximum value the key can be (minimum is 0); this value is
- *              usually the size of the array.
- * @return Positive integer key associated to the item.
+ * @brief Measure the size up to which the serial sort beats starting threads.
  *
- * This is similar to an hash function; to be used when the elements stored in
- * the array are not all positive integers or not integers at all.
+ * Threads pay off once the work they split is larger than the time spent
+ * starting and synchronizing them. Relies on the element cost measured by the
+ * calibration.
+ * @param nthreads: Number of threads, 0 for the default team.
+ * @return Maximum size of the arrays to sort serially.
  */
-static long key(int item, long long max) {
-    return item;
+static long long measure_serial_threshold(int nthreads) {
+    long long threshold = FUSED_MAX_SIZE;
+
+    nthreads = team_size(nthreads);
+    if (nthreads > 1) {
+        double begin = monotonic_time();
+        for (int r = 0; r < CALIBRATION_ROUNDS; r++) {
+            #pragma omp parallel num_threads(nthreads)
+            {
+                #pragma omp barrier
+            }
+        }
+        double fork_cost = (monotonic_time() - begin) / CALIBRATION_ROUNDS;
+        double speedup_loss = 1.0 - 1.0 / nthreads;
+        long long measured = 4 * fork_cost /
+                             (tuning.element_cost * speedup_loss);
+        if (measured < threshold)
+            threshold = measured;
+    }
+    return threshold;
+}
+
+
+void counting_sort_calibrate(int nthreads) {
+    counting_sort_ctx *ctx = counting_sort_ctx_create(1);
+    int small[64], large[4096];
+    unsigned seed = 1;
+    double begin = 0;
+
+    /* Insertion Sort: cost of a comparison (n^2 / 4 of them, on average). */
+    begin = monotonic_time();
+    for (int r = 0; r < CALIBRATION_ROUNDS; r++) {
+        for (int i = 0; i < 64; i++)
+            small[i] = rand_r(&seed) % 4096;
+        insertion_sort(small, 64);
+    }
+    tuning.insertion_cost = (monotonic_time() - begin) /
+                            CALIBRATION_ROUNDS / (64 * 64 / 4);
+
+    /* Counting Sort: cost of an element, with a negligible range... */
+    begin = monotonic_time();
+    for (int r = 0; r < CALIBRATION_ROUNDS; r++) {
+        for (int i = 0; i < 4096; i++)
+            large[i] = rand_r(&seed) % 16;
+        large[0] = 0;
+        large[1] = 15;
+        serial_counting_sort(ctx, large, 4096, 0, 15);
+    }
+    tuning.element_cost = (monotonic_time() - begin) / CALIBRATION_ROUNDS /
+                          4096;
+
+    /* ... and cost of a bucket, with a negligible number of elements. */
+    begin = monotonic_time();
+    for (int r = 0; r < CALIBRATION_ROUNDS; r++) {
+        small[0] = 0;
+        small[1] = 8191;
+        serial_counting_sort(ctx, small, 2, 0, 8191);
+    }
+    tuning.bucket_cost = (monotonic_time() - begin) / CALIBRATION_ROUNDS /
+                         8192;
+
+    forget_thresholds();
+    long long slot = threshold_slot(nthreads);
+    tuning.serial_threshold[slot] = measure_serial_threshold(nthreads);
+    #pragma omp atomic write seq_cst
+    tuning.calibrated = 1;
+    counting_sort_ctx_destroy(ctx);
+}
+
+
+void counting_sort_set_thresholds(double insertion_cost, double element_cost,
+                                  double bucket_cost,
+                                  long long serial_threshold, int nthreads)
+{
+    tuning.insertion_cost = insertion_cost;
+    tuning.element_cost = element_cost;
+    tuning.bucket_cost = bucket_cost;
+    forget_thresholds();
+    tuning.serial_threshold[threshold_slot(nthreads)] = serial_threshold;
+    #pragma omp atomic write seq_cst
+    tuning.calibrated = 1;
+}
+
+
+/**
+ * @brief Calibrate the costs, unless they have already been measured or set:
+ *        they are serial, so they hold for any number of threads.
+ * @param nthreads: Number of threads of the sort that needs them.
+ */
+static void calibrate_once(int nthreads) {
+    int calibrated = 0;
+    #pragma omp atomic read seq_cst
+    calibrated = tuning.calibrated;
+    if (!calibrated) {
+        #pragma omp critical (counting_sort_calibration)
+        {
+            if (!tuning.calibrated)
+                counting_sort_calibrate(nthreads);
+        }
+    }
+}
+
+
+/**
+ * @brief Size up to which starting the threads does not pay off, measured the
+ *        first time a number of threads needs it and then cached.
+ * @param nthreads: Number of threads of the sort, 0 for the default team.
+ * @return Maximum size of the arrays to sort serially.
+ */
+static long long serial_threshold(int nthreads) {
+    long long slot = threshold_slot(nthreads);
+    long long threshold = 0;
+
+    calibrate_once(nthreads);
+    #pragma omp atomic read
+    threshold = tuning.serial_threshold[slot];
+    if (threshold < 0) {
+        #pragma omp critical (counting_sort_calibration)
+        {
+            threshold = tuning.serial_threshold[slot];
+            if (threshold < 0) {
+                threshold = measure_serial_threshold(nthreads);
+                #pragma omp atomic write
+                tuning.serial_threshold[slot] = threshold;
+            }
+        }
+    }
+    return threshold;
+}
+
+
+counting_sort_ctx *counting_sort_ctx_create(int nthreads) {
+    counting_sort_ctx *ctx = (counting_sort_ctx *)
+                             safe_alloc(sizeof(counting_sort_ctx));
+    ctx->nthreads = nthreads;
+    ctx->count = ctx->offset = ctx->scratch = ctx->buffer = NULL;
+    ctx->count_bytes = ctx->offset_bytes = 0;
+    ctx->scratch_bytes = ctx->buffer_bytes = 0;
+    ctx->decision = (sort_decision){STRATEGY_INSERTION, 0, 0, 0, -1};
+    return ctx;
+}
+
+
+void counting_sort_ctx_reserve(counting_sort_ctx *ctx, long long size,
+                               long long count_size)
+{
+    count_width width = histogram_width(size);
+    int nthreads = team_size(ctx->nthreads);
+
+    ctx_reserve(&ctx->count, &ctx->count_bytes,
+                count_item_size(width) * count_size, nthreads);
+    ctx_reserve(&ctx->scratch, &ctx->scratch_bytes,
+                histogram_scratch_size(count_size, width, nthreads), nthreads);
+    ctx_reserve(&ctx->offset, &ctx->offset_bytes,
+                sizeof(long long) * (count_size + 1), nthreads);
+}
+
+
+void counting_sort_ctx_destroy(counting_sort_ctx *ctx) {
+    if (ctx == NULL)
+        return;
+    free(ctx->count);
+    free(ctx->offset);
+    free(ctx->scratch);
+    free(ctx->buffer);
+    free(ctx);
+}
+
+
+void counting_sort_range(int *array, long long size, int min, int max,
+                         int nthreads)
+{
+    counting_sort_ctx *ctx = counting_sort_ctx_create(nthreads);
+    sort_range_with_ctx(ctx, array, size, min, max);
+    counting_sort_ctx_destroy(ctx);
 }
 
 
 void counting_sort(int *array, long long size, int nthreads) {
-    long long i = 0, j = 0, k = 0;
-    int max = 0, min = 0;
+    counting_sort_ctx *ctx = counting_sort_ctx_create(nthreads);
+    counting_sort_with_ctx(ctx, array, size);
+    counting_sort_ctx_destroy(ctx);
+}
+
+
+void counting_sort_copy(const int *array, int *out, long long size,
+                        int nthreads)
+{
+    int min = 0, max = 0;
+
+    if (size < 1)
+        return;
+
     min_max(array, size, &min, &max, nthreads);
-    long long count_size = max - min + 1;
-    int *count = (int *)safe_alloc(sizeof(int) * count_size);
+    long long count_size = (long long)max - min + 1;
 
-    /* Initialize every item of count[] with the value 0. */
-    #pragma omp parallel for num_threads(nthreads) shared(count, count_size) \
-            private(i)
-    for (i = 0; i < count_size; i++)
-        count[i] = 0;
+    if (use_radix(count_size, size)) {
+        /* Radix Sort and hash-based counting work in place. */
+        #pragma omp parallel num_threads(nthreads) shared(array, out, size)
+        {
+            long long nt = omp_get_num_threads();
+            long long t = omp_get_thread_num();
+            long long begin = BLOCK_BEGIN(size, t, nt);
+            memcpy(out + begin, array + begin,
+                   sizeof(int) * (BLOCK_BEGIN(size, t + 1, nt) - begin));
+        }
+        counting_sort(out, size, nthreads);
+        return;
+    }
+
+    counting_sort_ctx *ctx = counting_sort_ctx_create(nthreads);
+    count_width width = histogram_width(size);
+    ctx_histogram(ctx, array, size, min, count_size, width, NULL, NULL);
+    ctx_write_back(ctx, out, size, min, count_size, width);
+    counting_sort_ctx_destroy(ctx);
+}
+
+
+void counting_sort_fill(int *out, long long first, long long n,
+                        const long long *offset, long long count_size,
+                        int min, int nthreads)
+{
+    #pragma omp parallel num_threads(nthreads) shared(out, offset)
+    {
+        long long nt = omp_get_num_threads();
+        long long t = omp_get_thread_num();
+        long long pos = BLOCK_BEGIN(n, t, nt);
+        long long end = BLOCK_BEGIN(n, t + 1, nt);
+
+        profile_begin(PHASE_SCATTER);
+        if (pos < end) {
+            long long b = find_bucket(offset, count_size, first + pos);
+            for (; pos < end; b++) {
+                long long run_end = offset[b + 1] - first < end
+                                  ? offset[b + 1] - first : end;
+                fill_run_i32(out, pos, run_end, end, min + b);
+                pos = run_end > pos ? run_end : pos;
+            }
+        }
+        profile_end(PHASE_SCATTER);
+    }
+}
+
+
+void counting_sort_with_ctx(counting_sort_ctx *ctx, int *array,
+                            long long size)
+{
+    int max = 0, min = 0;
+
+    if (size < 2) {
+        ctx->decision = (sort_decision){STRATEGY_INSERTION, 0, 0, 0, -1};
+        return;
+    }
+
+    if (size <= serial_threshold(ctx->nthreads)) {
+        serial_sort(ctx, array, size);
+        return;
+    }
+    if (size <= FUSED_MAX_SIZE) {
+        if (!fused_counting_sort(ctx, array, size))
+            sort_wide_range(ctx, array, size);
+        return;
+    }
 
     /*
-     * Increment count[j] for every repeated occurrence of array[i] found in the
-     * array.
-     *
-     * Reduction on an array supported from OpenMP version 4.5+.
+     * Speculative histogram: count the values falling into the guessed range
+     * and, in the same pass, keep track of the extremes of the ones that fall
+     * outside of it. When the sample spans a range too wide to count, the
+     * band holding most of it is counted instead, in case the width is only
+     * due to a few outliers.
      */
-    #pragma omp parallel for num_threads(nthreads) shared(array, min, size) \
-            private(i, j) reduction(+: count[:count_size])
-    for (i = 0; i < size; i++) {
-        j = key(array[i], size) - min;
-        count[j] += 1;
+    guess_range(array, size, &min, &max);
+    long long count_size = (long long)max - min + 1;
+    if (use_radix(count_size, size)) {
+        guess_band(array, size, &min, &max);
+        count_size = (long long)max - min + 1;
+        if (use_radix(count_size, size)) {
+            sort_wide_range(ctx, array, size);
+            return;
+        }
+    }
+    count_width width = histogram_width(size);
+    int seen_min = min, seen_max = max;
+    ctx->decision = (sort_decision){STRATEGY_DENSE, min, max, 0, -1};
+
+    long long skipped = ctx_histogram(ctx, array, size, min, count_size, width,
+                                      &seen_min, &seen_max);
+
+    /*
+     * The guess was wrong: count again, on a histogram large enough to hold
+     * every value; if that is too wide but only a few values are out of the
+     * guessed range, leave them out and sort them on their own.
+     */
+    if (skipped > 0) {
+        int full_min = seen_min < min ? seen_min : min;
+        int full_max = seen_max > max ? seen_max : max;
+        long long full_size = (long long)full_max - full_min + 1;
+        if (!use_radix(full_size, size)) {
+            ctx->decision.min = min = full_min;
+            ctx->decision.max = max = full_max;
+            count_size = full_size;
+            ctx_histogram(ctx, array, size, min, count_size, width, NULL,
+                          NULL);
+        }
+        else if (skipped * OUTLIER_RATIO <= size) {
+            ctx->decision.strategy = STRATEGY_OUTLIER_SPLIT;
+            ctx->decision.outliers = skipped;
+            sort_split_outliers(ctx, array, size, min, count_size, width,
+                                skipped);
+            return;
+        }
+        else {
+            sort_wide_range(ctx, array, size);
+            return;
+        }
+    }
+
+    ctx_write_back(ctx, array, size, min, count_size, width);
+}
+
+
+const sort_decision *counting_sort_ctx_decision(const counting_sort_ctx *ctx) {
+    return &ctx->decision;
+}
+
+
+const char *strategy_name(sort_strategy strategy) {
+    static const char *names[] = {"insertion", "dense", "outlier-split",
+                                  "sparse", "radix"};
+    return names[strategy];
+}
+
+
+/**
+ * @brief Sort one of the arrays of counting_sort_batch() that is split among
+ *        the threads, with a task for every block of every phase.
+ * @param array:    The array.
+ * @param size:     Number of elements stored in the array; less than 2^32.
+ * @param nthreads: Number of threads of the team running the tasks.
+ * @return 0 if the range is too wide to be counted, and the array is left as
+ *         it is, 1 otherwise.
+ *
+ * The phases are the same of counting_sort(), with private histograms of
+ * 32-bit counters. Every phase waits for its own tasks only: while it does,
+ * its thread and the idle ones keep running the tasks of the other arrays,
+ * so the counting of an array overlaps with the write-back of another.
+ */
+static int batch_split_sort(int *array, long long size, int nthreads) {
+    long long nblocks = nthreads > 1 ? nthreads : 1;
+    long long nslices = BATCH_SLICES * nblocks;
+    long long b = 0, k = 0;
+    int *mins = (int *)safe_alloc(sizeof(int) * nblocks);
+    int *maxs = (int *)safe_alloc(sizeof(int) * nblocks);
+
+    #pragma omp taskloop grainsize(1) shared(array, mins, maxs)
+    for (k = 0; k < nblocks; k++) {
+        long long begin = BLOCK_BEGIN(size, k, nblocks);
+        profile_begin(PHASE_MIN_MAX);
+        mins[k] = maxs[k] = array[begin];
+        min_max_block(array + begin, BLOCK_BEGIN(size, k + 1, nblocks) - begin,
+                      &mins[k], &maxs[k]);
+        profile_end(PHASE_MIN_MAX);
+    }
+
+    int min = mins[0], max = maxs[0];
+    for (k = 1; k < nblocks; k++) {
+        min = mins[k] < min ? mins[k] : min;
+        max = maxs[k] > max ? maxs[k] : max;
+    }
+    free(mins);
+    free(maxs);
+
+    long long count_size = (long long)max - min + 1;
+    if (use_radix(count_size, size))
+        return 0;
+
+    uint32_t *blocks = (uint32_t *)safe_alloc(sizeof(uint32_t) * count_size *
+                                              nblocks);
+    long long *offset = (long long *)safe_alloc(sizeof(long long) *
+                                                (count_size + 1));
+
+    #pragma omp taskloop grainsize(1) shared(array, blocks)
+    for (k = 0; k < nblocks; k++) {
+        uint32_t *count = blocks + k * count_size;
+        profile_begin(PHASE_ZERO_FILL);
+        memset(count, 0, sizeof(uint32_t) * count_size);
+        profile_end(PHASE_ZERO_FILL);
+        profile_begin(PHASE_HISTOGRAM);
+        for (long long i = BLOCK_BEGIN(size, k, nblocks);
+             i < BLOCK_BEGIN(size, k + 1, nblocks); i++)
+            count[array[i] - min] += 1;
+        profile_end(PHASE_HISTOGRAM);
+    }
+
+    #pragma omp taskloop grainsize(MERGE_BLOCK) shared(blocks, offset)
+    for (b = 0; b < count_size; b++) {
+        long long sum = 0;
+        for (long long j = 0; j < nblocks; j++)
+            sum += blocks[j * count_size + b];
+        offset[b] = sum;
+    }
+    free(blocks);
+
+    profile_begin(PHASE_MERGE);
+    long long sum = 0;
+    for (b = 0; b < count_size; b++) {
+        long long c = offset[b];
+        offset[b] = sum;
+        sum += c;
+    }
+    offset[count_size] = sum;
+    profile_end(PHASE_MERGE);
+
+    #pragma omp taskloop grainsize(1) shared(array, offset)
+    for (k = 0; k < nslices; k++) {
+        long long pos = BLOCK_BEGIN(size, k, nslices);
+        long long end = BLOCK_BEGIN(size, k + 1, nslices);
+        if (pos >= end)
+            continue;
+
+        profile_begin(PHASE_SCATTER);
+        for (long long v = find_bucket(offset, count_size, pos); pos < end;
+             v++) {
+            long long run_end = offset[v + 1] < end ? offset[v + 1] : end;
+            fill_run_i32(array, pos, run_end, end, min + v);
+            pos = run_end > pos ? run_end : pos;
+        }
+        profile_end(PHASE_SCATTER);
     }
 
+    free(offset);
+}
+
+
+void counting_sort_batch(int **arrays, const long long *sizes, int narrays,
+                         int nthreads)
+{
+    long long total = 0;
+    /* Resolved first: the contexts are indexed by the id of the thread. */
+    int nslots = team_size(nthreads);
+    int i = 0;
+
+    for (i = 0; i < narrays; i++)
+        total += sizes[i];
+    if (total == 0)
+        return;
+
+    /* Only the serial costs are used, valid for any number of threads. */
+    calibrate_once(nthreads);
+
     /*
-     * Nested loops in which the iterations of the inner one depend on the value
-     * of the outer one: they cannot collapse into one; moreover, there's a
-     * data dependence on the k variable. There seems to be no easy way to
-     * parallelize this section of the algorithm.
+     * An array is split among the threads when sorting it whole would take
+     * longer than a fair share of the batch; the smaller ones are sorted by a
+     * single thread each, with no synchronization at all.
      */
-    for (i = min; i <= max; i++)
-        for (j = 0; j < count[i - min]; j++)
-            array[k++] = i;
+    long long share = total / nslots;
+    share = share < FUSED_MAX_SIZE ? FUSED_MAX_SIZE : share;
 
+    counting_sort_ctx **ctxs = (counting_sort_ctx **)
+                               safe_alloc(sizeof(counting_sort_ctx *) * nslots);
+    for (int t = 0; t < nslots; t++)
+        ctxs[t] = counting_sort_ctx_create(1);
+    /* Set by the split arrays whose range is too wide to be counted. */
+    char *wide = (char *)safe_alloc(narrays);
+    memset(wide, 0, narrays);
+
+    #pragma omp parallel num_threads(nslots) \
+            shared(arrays, sizes, ctxs, wide) private(i)
+    {
+        #pragma omp single
+        {
+            /* The split arrays first, so that their tasks are spawned early. */
+            for (i = 0; i < narrays; i++) {
+                if (sizes[i] <= share || sizes[i] > UINT32_MAX)
+                    continue;
+                #pragma omp task firstprivate(i)
+                wide[i] = !batch_split_sort(arrays[i], sizes[i], nslots);
+            }
+
+            for (i = 0; i < narrays; i++) {
+                if (sizes[i] < 2 || sizes[i] > share || sizes[i] > UINT32_MAX)
+                    continue;
+                /*
+                 * The task has no scheduling point: no other task can run on
+                 * its thread, and use the thread's context, until it ends.
+                 */
+                #pragma omp task firstprivate(i)
+                serial_sort(ctxs[omp_get_thread_num()], arrays[i], sizes[i]);
+            }
+        }
+    }
+
+    /*
+     * Too large for 32-bit counters, or too wide a range to be counted by
+     * tasks: sorted one at a time by all threads.
+     */
+    counting_sort_ctx *team = counting_sort_ctx_create(nthreads);
+    for (i = 0; i < narrays; i++) {
+        if (sizes[i] > UINT32_MAX)
+            counting_sort_with_ctx(team, arrays[i], sizes[i]);
+        else if (wide[i])
+            sort_wide_range(team, arrays[i], sizes[i]);
+    }
+    counting_sort_ctx_destroy(team);
+    free(wide);
+
+    for (int t = 0; t < nslots; t++)
+        counting_sort_ctx_destroy(ctxs[t]);
+    free(ctxs);
+}
+
+
+/**
+ * @brief Return the number of values in the range [min; max], exiting the
+ *        program if their histogram could not be addressed.
+ * @param min: Minimum value.
+ * @param max: Maximum value.
+ * @return max - min + 1.
+ */
+static long long range_size(long long min, long long max) {
+    unsigned long long span = (unsigned long long)max - min;
+    if (span >= LLONG_MAX / sizeof(uint64_t)) {
+        fprintf(stderr, "Can not count values in the range [%lld; %lld].\n",
+                min, max);
+        exit(EXIT_FAILURE);
+    }
+    return span + 1;
+}
+
+
+void counting_sort_u8(uint8_t *array, long long size, int nthreads) {
+    /* The whole range of the type is small enough to be counted directly. */
+    count_width width = histogram_width(size);
+    void *count = safe_alloc(count_item_size(width) * (UINT8_MAX + 1));
+
+    histogram_build_typed(array, ELEM_U8, size, 0, count, UINT8_MAX + 1,
+                          width, NULL, NULL, HISTOGRAM_AUTO, nthreads);
+
+    write_back(array, ELEM_U8, size, count, UINT8_MAX + 1, width, 0, NULL,
+               nthreads);
     free(count);
 }
+
+
+void counting_sort_u16(uint16_t *array, long long size, int nthreads) {
+    count_width width = histogram_width(size);
+    void *count = safe_alloc(count_item_size(width) * (UINT16_MAX + 1));
+
+    histogram_build_typed(array, ELEM_U16, size, 0, count, UINT16_MAX + 1,
+                          width, NULL, NULL, HISTOGRAM_AUTO, nthreads);
+
+    write_back(array, ELEM_U16, size, count, UINT16_MAX + 1, width, 0, NULL,
+               nthreads);
+    free(count);
+}
+
+
+void counting_sort_i64(int64_t *array, long long size, int nthreads) {
+    long long i = 0;
+    int64_t min = array[0], max = array[0];
+
+    #pragma omp parallel for num_threads(nthreads) shared(array, size) \
+            private(i) reduction(min: min) reduction(max: max)
+    for (i = 0; i < size; i++) {
+        min = array[i] < min ? array[i] : min;
+        max = array[i] > max ? array[i] : max;
+    }
+
+    long long count_size = range_size(min, max);
+    count_width width = histogram_width(size);
+    void *count = safe_alloc(count_item_size(width) * count_size);
+
+    histogram_build_typed(array, ELEM_I64, size, min, count, count_size, width,
+                          NULL, NULL, HISTOGRAM_AUTO, nthreads);
+
+    write_back(array, ELEM_I64, size, count, count_size, width, min, NULL,
+               nthreads);
+    free(count);
+}
+
+
+/** @brief Keys of a stable sort: either an array of int or of records. */
+typedef struct {
+    /** The array. */
+    const void *data;
+    /** Size, in bytes, of an element of the array. */
+    long long record_size;
+    /** Function returning the key of a record; NULL for an array of int. */
+    key_extractor key;
+} sort_input;
+
+
+/**
+ * @brief Return the key of the i-th element of the input.
+ * @param in: The input.
+ * @param i:  Index of the element.
+ * @return The key.
+ */
+static inline long long input_key(const sort_input *in, long long i) {
+    if (in->key == NULL)
+        return ((const int *)in->data)[i];
+    return in->key((const char *)in->data + i * in->record_size);
+}
+
+
+/**
+ * @brief Find the minimum and maximum keys of the input.
+ * @param in:       The input.
+ * @param size:     Number of elements in the input.
+ * @param min:      Minimum key (output); 0 if the input is empty.
+ * @param max:      Maximum key (output); 0 if the input is empty.
+ * @param nthreads: Number of threads to use when OpenMP parallelization is
+ *                  enabled.
+ */
+static void input_range(const sort_input *in, long long size, long long *min,
+                        long long *max, int nthreads)
+{
+    if (size < 1) {
+        *min = 0;
+        *max = 0;
+        return;
+    }
+
+    if (in->key == NULL) {
+        int imin = 0, imax = 0;
+        min_max(in->data, size, &imin, &imax, nthreads);
+        *min = imin;
+        *max = imax;
+        return;
+    }
+
+    long long i = 0;
+    long long lmin = input_key(in, 0), lmax = lmin;
+
+    #pragma omp parallel for num_threads(nthreads) shared(in, size) \
+            private(i) reduction(min: lmin) reduction(max: lmax)
+    for (i = 0; i < size; i++) {
+        long long k = input_key(in, i);
+        lmin = k < lmin ? k : lmin;
+        lmax = k > lmax ? k : lmax;
+    }
+
+    *min = lmin;
+    *max = lmax;
+}
+
+
+/**
+ * @brief Return a counter of the block histograms.
+ * @param blocks: The histograms.
+ * @param width:  Width of their counters.
+ * @param b:      Index of the counter.
+ * @return The counter.
+ */
+static inline long long block_count(const void *blocks, count_width width,
+                                    long long b)
+{
+    return width == COUNT_64 ? ((const uint64_t *)blocks)[b]
+                             : ((const uint32_t *)blocks)[b];
+}
+
+
+/**
+ * @brief Compute where every block of the input has to write each of its keys.
+ * @param in:         The input.
+ * @param size:       Number of elements in the input.
+ * @param min:        Minimum key.
+ * @param count_size: Number of keys in the range.
+ * @param nblocks:    Number of blocks the input is split into.
+ * @param nthreads:   Number of threads to use when OpenMP parallelization is
+ *                    enabled.
+ * @return Array of `nblocks * count_size` items; item `t * count_size + j` is
+ *         the position of the first element of block t with key `min + j`.
+ *
+ * The offsets follow the order of the keys first and the order of the blocks
+ * second, which is what makes the sort stable.
+ */
+static long long *block_offsets(const sort_input *in, long long size,
+                                long long min, long long count_size,
+                                long long nblocks, int nthreads)
+{
+    count_width width = histogram_width(size);
+    void *blocks = safe_alloc(count_item_size(width) * count_size * nblocks);
+    long long *offset = (long long *)safe_alloc(sizeof(long long) *
+                                                count_size * nblocks);
+
+    if (in->key == NULL)
+        histogram_blocks_typed(in->data, ELEM_I32, size, min, blocks,
+                               count_size, width, nblocks, nthreads);
+    else
+        histogram_blocks_records(in->data, size, in->record_size, in->key, min,
+                                 blocks, count_size, width, nblocks, nthreads);
+
+    /*
+     * The offsets of key j are the total of the keys before it, plus the
+     * occurrences of j in the blocks before: every iteration works on its
+     * own range of keys, across all the blocks.
+     */
+    uint64_t *total = (uint64_t *)safe_alloc(sizeof(uint64_t) * count_size);
+    long long *base = (long long *)safe_alloc(sizeof(long long) *
+                                              (count_size + 1));
+    long long nmerge = (count_size + MERGE_BLOCK - 1) / MERGE_BLOCK, m = 0;
+
+    #pragma omp parallel for num_threads(nthreads) default(shared) private(m)
+    for (m = 0; m < nmerge; m++) {
+        long long first = m * MERGE_BLOCK;
+        long long last = first + MERGE_BLOCK < count_size
+                       ? first + MERGE_BLOCK : count_size;
+        for (long long j = first; j < last; j++)
+            total[j] = 0;
+        for (long long t = 0; t < nblocks; t++)
+            for (long long j = first; j < last; j++)
+                total[j] += block_count(blocks, width, t * count_size + j);
+    }
+
+    counting_sort_offsets(total, count_size, COUNT_64, base);
+
+    #pragma omp parallel for num_threads(nthreads) default(shared) private(m)
+    for (m = 0; m < nmerge; m++) {
+        long long first = m * MERGE_BLOCK;
+        long long last = first + MERGE_BLOCK < count_size
+                       ? first + MERGE_BLOCK : count_size;
+        for (long long j = first; j < last; j++)
+            offset[j] = base[j];
+        for (long long t = 1; t < nblocks; t++)
+            for (long long j = first; j < last; j++) {
+                long long b = t * count_size + j;
+                offset[b] = offset[b - count_size] +
+                            block_count(blocks, width, b - count_size);
+            }
+    }
+
+    free(total);
+    free(base);
+    free(blocks);
+    return offset;
+}
+
+
+/**
+ * @brief Compute the sorting permutation of the input, with a stable LSD
+ *        Radix Sort of its keys.
+ * @param in:       The input.
+ * @param size:     Number of elements in the input.
+ * @param min:      Minimum key.
+ * @param span:     Maximum key minus the minimum one.
+ * @param nthreads: Number of threads, and of blocks every pass is split into;
+ *                  already resolved with team_size().
+ * @return Array of `size` items, the index in the input of every element in
+ *         the sorted order; to be released with free().
+ *
+ * The keys are reduced to `key - min`, so only the digits up to the highest
+ * bit of `span` are sorted. As in radix_sort(), every pass moves (key, index)
+ * pairs block by block, to positions ordered by digit first and by block
+ * second, which keeps equal keys in the order of the input.
+ */
+static long long *radix_permutation(const sort_input *in, long long size,
+                                    long long min, unsigned long long span,
+                                    int nthreads)
+{
+    long long nblocks = nthreads;
+    uint64_t *keys = (uint64_t *)safe_alloc(sizeof(uint64_t) * size);
+    uint64_t *keys_tmp = (uint64_t *)safe_alloc(sizeof(uint64_t) * size);
+    long long *order = (long long *)safe_alloc(sizeof(long long) * size);
+    long long *order_tmp = (long long *)safe_alloc(sizeof(long long) * size);
+    long long *offset = (long long *)safe_alloc(sizeof(long long) *
+                                                RADIX_BUCKETS * nblocks);
+    long long i = 0, t = 0;
+
+    #pragma omp parallel for num_threads(nthreads) default(shared) private(i)
+    for (i = 0; i < size; i++) {
+        keys[i] = (uint64_t)input_key(in, i) - (uint64_t)min;
+        order[i] = i;
+    }
+
+    for (int shift = 0; shift < 64 && (span >> shift) > 0;
+         shift += RADIX_BITS) {
+        /* Count the occurrences of every digit, block by block. */
+        #pragma omp parallel for num_threads(nthreads) default(shared) \
+                private(t)
+        for (t = 0; t < nblocks; t++) {
+            long long *mine = offset + RADIX_BUCKETS * t;
+            for (long long d = 0; d < RADIX_BUCKETS; d++)
+                mine[d] = 0;
+            for (long long j = BLOCK_BEGIN(size, t, nblocks);
+                 j < BLOCK_BEGIN(size, t + 1, nblocks); j++)
+                mine[(keys[j] >> shift) & (RADIX_BUCKETS - 1)] += 1;
+        }
+
+        long long sum = 0;
+        for (long long d = 0; d < RADIX_BUCKETS; d++)
+            for (t = 0; t < nblocks; t++) {
+                long long occurrences = offset[RADIX_BUCKETS * t + d];
+                offset[RADIX_BUCKETS * t + d] = sum;
+                sum += occurrences;
+            }
+
+        #pragma omp parallel for num_threads(nthreads) default(shared) \
+                private(t)
+        for (t = 0; t < nblocks; t++) {
+            long long *mine = offset + RADIX_BUCKETS * t;
+            for (long long j = BLOCK_BEGIN(size, t, nblocks);
+                 j < BLOCK_BEGIN(size, t + 1, nblocks); j++) {
+                unsigned d = (keys[j] >> shift) & (RADIX_BUCKETS - 1);
+                long long pos = mine[d]++;
+                keys_tmp[pos] = keys[j];
+                order_tmp[pos] = order[j];
+            }
+        }
+
+        uint64_t *swap_keys = keys;
+        keys = keys_tmp;
+        keys_tmp = swap_keys;
+        long long *swap_order = order;
+        order = order_tmp;
+        order_tmp = swap_order;
+    }
+
+    free(keys);
+    free(keys_tmp);
+    free(order_tmp);
+    free(offset);
+    return order;
+}
+
+
+/**
+ * @brief Write an element of the input, with its payload and its index, at a
+ *        position of the outputs.
+ * @param in:  The input.
+ * @param i:   Index of the element in the input.
+ * @param pos: Position of the element in the sorted order.
+ *
+ * All the other parameters are the same as stable_sort().
+ */
+static inline void stable_place(const sort_input *in, long long i,
+                                long long pos, const void *values,
+                                long long value_size, void *keys_out,
+                                void *values_out, long long *perm)
+{
+    if (keys_out != NULL && in->key == NULL)
+        ((int *)keys_out)[pos] = ((const int *)in->data)[i];
+    else if (keys_out != NULL)
+        memcpy((char *)keys_out + pos * in->record_size,
+               (const char *)in->data + i * in->record_size,
+               in->record_size);
+    if (values_out != NULL)
+        memcpy((char *)values_out + pos * value_size,
+               (const char *)values + i * value_size, value_size);
+    if (perm != NULL)
+        perm[pos] = i;
+}
+
+
+/**
+ * @brief Stable counting sort of the input, with its optional payload.
+ * @param in:         The keys.
+ * @param size:       Number of elements in the input.
+ * @param values:     Payload associated to the keys, or NULL.
+ * @param value_size: Size, in bytes, of a single item of the payload.
+ * @param keys_out:   Where to write the sorted elements of the input, or NULL.
+ * @param values_out: Where to write the payload in the sorted order, or NULL.
+ * @param perm:       Where to write the index (in the input) of every element
+ *                    in the sorted order, or NULL.
+ * @param nthreads:   Number of threads to use when OpenMP parallelization is
+ *                    enabled.
+ *
+ * Every thread scatters its own block of the input to the offsets computed
+ * for that block, so no two threads ever write to the same position. As in
+ * counting_sort(), a range of keys much wider than the input is not counted:
+ * the permutation is then found by radix_permutation().
+ */
+static void stable_sort(const sort_input *in, long long size,
+                        const void *values, long long value_size,
+                        void *keys_out, void *values_out, long long *perm,
+                        int nthreads)
+{
+    long long min = 0, max = 0, t = 0;
+
+    if (size < 1)
+        return;
+
+    nthreads = team_size(nthreads);
+    input_range(in, size, &min, &max, nthreads);
+    unsigned long long span = (unsigned long long)max - min;
+
+    if (span >= LLONG_MAX / sizeof(uint64_t) || use_radix(span + 1, size)) {
+        long long *order = radix_permutation(in, size, min, span, nthreads);
+        #pragma omp parallel for num_threads(nthreads) default(shared) \
+                private(t)
+        for (t = 0; t < size; t++)
+            stable_place(in, order[t], t, values, value_size, keys_out,
+                         values_out, perm);
+        free(order);
+        return;
+    }
+
+    long long count_size = span + 1;
+    long long nblocks = nthreads;
+    long long *offset = block_offsets(in, size, min, count_size, nblocks,
+                                      nthreads);
+
+    #pragma omp parallel for num_threads(nthreads) default(shared) private(t)
+    for (t = 0; t < nblocks; t++) {
+        long long *mine = offset + count_size * t;
+        for (long long i = BLOCK_BEGIN(size, t, nblocks);
+             i < BLOCK_BEGIN(size, t + 1, nblocks); i++)
+            stable_place(in, i, mine[input_key(in, i) - min]++, values,
+                         value_size, keys_out, values_out, perm);
+    }
+
+    free(offset);
+}
+
+
+void counting_sort_records(const void *records, void *out, long long size,
+                           long long record_size, key_extractor key,
+                           int nthreads)
+{
+    sort_input in = {records, record_size, key};
+    stable_sort(&in, size, NULL, 0, out, NULL, NULL, nthreads);
+}
+
+
+void counting_sort_records_perm(const void *records, long long *perm,
+                                long long size, long long record_size,
+                                key_extractor key, int nthreads)
+{
+    sort_input in = {records, record_size, key};
+    stable_sort(&in, size, NULL, 0, NULL, NULL, perm, nthreads);
+}
+
+
+void counting_sort_by_key(const int *keys, const void *values, long long size,
+                          long long value_size, int *keys_out,
+                          void *values_out, int nthreads)
+{
+    sort_input in = {keys, sizeof(int), NULL};
+    stable_sort(&in, size, values, value_size, keys_out, values_out, NULL,
+                nthreads);
+}
+
+
+void counting_sort_perm(const int *keys, long long *perm, long long size,
+                        int nthreads)
+{
+    sort_input in = {keys, sizeof(int), NULL};
+    stable_sort(&in, size, NULL, 0, NULL, NULL, perm, nthreads);
+}
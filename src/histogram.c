@@ -0,0 +1,380 @@
+/**
+ * @file histogram.c
+ * @brief This file contains the functions building the histogram of an array.
+ * @author Marco Plaitano
+ * @date 29 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "histogram.h"
+
+#ifdef _OPENMP
+    #include <omp.h>
+#else
+    #define omp_get_thread_num() 0
+    #define omp_get_num_threads() 1
+#endif
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "profile.h"
+#include "tuning.h"
+#include "util.h"
+
+
+/**
+ * @brief Signature shared by all the kernels building a histogram.
+ * @param data:        The elements to count.
+ * @param record_size: Size, in bytes, of every element; only used with records.
+ * @param extract:     Function returning the key of a record; only used with
+ *                     records.
+ * @param size:        Number of elements.
+ * @param min:         Key associated to count[0].
+ * @param count:       The counters (output).
+ * @param count_size:  Number of counters.
+ * @param out_min:     Smallest key found outside of the range (output).
+ * @param out_max:     Largest key found outside of the range (output).
+ * @param scratch:     Memory for the private histograms, or NULL to allocate
+ *                     it; see histogram_scratch_size().
+ * @param nthreads:    Number of threads to use when OpenMP parallelization is
+ *                     enabled.
+ * @return Number of elements found outside of the range.
+ *
+ * Integer elements are their own key; for all the other kinds of elements, the
+ * key is what used to be called the "hash" of the item: a positive integer
+ * representing it, to use as index in count[] once `min` is subtracted.
+ */
+typedef long long (*histogram_kernel)(const void *data, long long record_size,
+                                      key_extractor extract, long long size,
+                                      long long min, void *count,
+                                      long long count_size,
+                                      long long *out_min, long long *out_max,
+                                      void *scratch, int nthreads);
+
+
+#define COUNT_T uint32_t
+#define KEY(i) ((const uint8_t *)data)[i]
+#define SUFFIX u8_32
+#include "histogram_template.h"
+#undef COUNT_T
+#undef KEY
+#undef SUFFIX
+
+#define COUNT_T uint64_t
+#define KEY(i) ((const uint8_t *)data)[i]
+#define SUFFIX u8_64
+#include "histogram_template.h"
+#undef COUNT_T
+#undef KEY
+#undef SUFFIX
+
+#define COUNT_T uint32_t
+#define KEY(i) ((const uint16_t *)data)[i]
+#define SUFFIX u16_32
+#include "histogram_template.h"
+#undef COUNT_T
+#undef KEY
+#undef SUFFIX
+
+#define COUNT_T uint64_t
+#define KEY(i) ((const uint16_t *)data)[i]
+#define SUFFIX u16_64
+#include "histogram_template.h"
+#undef COUNT_T
+#undef KEY
+#undef SUFFIX
+
+#define COUNT_T uint32_t
+#define KEY(i) ((const int32_t *)data)[i]
+#define SUFFIX i32_32
+#include "histogram_template.h"
+#undef COUNT_T
+#undef KEY
+#undef SUFFIX
+
+#define COUNT_T uint64_t
+#define KEY(i) ((const int32_t *)data)[i]
+#define SUFFIX i32_64
+#include "histogram_template.h"
+#undef COUNT_T
+#undef KEY
+#undef SUFFIX
+
+#define COUNT_T uint32_t
+#define KEY(i) ((const int64_t *)data)[i]
+#define SUFFIX i64_32
+#include "histogram_template.h"
+#undef COUNT_T
+#undef KEY
+#undef SUFFIX
+
+#define COUNT_T uint64_t
+#define KEY(i) ((const int64_t *)data)[i]
+#define SUFFIX i64_64
+#include "histogram_template.h"
+#undef COUNT_T
+#undef KEY
+#undef SUFFIX
+
+#define COUNT_T uint32_t
+#define KEY(i) extract((const char *)data + (i) * record_size)
+#define SUFFIX rec_32
+#include "histogram_template.h"
+#undef COUNT_T
+#undef KEY
+#undef SUFFIX
+
+#define COUNT_T uint64_t
+#define KEY(i) extract((const char *)data + (i) * record_size)
+#define SUFFIX rec_64
+#include "histogram_template.h"
+#undef COUNT_T
+#undef KEY
+#undef SUFFIX
+
+/*
+ * The whole range of the small unsigned types: bytes repeat so often that
+ * they are spread over 4 copies, while 4 copies of 2^16 counters would no
+ * longer fit in L2.
+ */
+#define COUNT_T uint32_t
+#define ELEM_T uint8_t
+#define LANES 4
+#define FULL_NAME histogram_full_u8_32
+#include "histogram_full_template.h"
+#undef COUNT_T
+#undef FULL_NAME
+
+#define COUNT_T uint64_t
+#define FULL_NAME histogram_full_u8_64
+#include "histogram_full_template.h"
+#undef COUNT_T
+#undef ELEM_T
+#undef LANES
+#undef FULL_NAME
+
+#define COUNT_T uint32_t
+#define ELEM_T uint16_t
+#define LANES 1
+#define FULL_NAME histogram_full_u16_32
+#include "histogram_full_template.h"
+#undef COUNT_T
+#undef ELEM_T
+#undef LANES
+#undef FULL_NAME
+
+/**
+ * @brief Kernels counting the whole range of ELEM_U8 and ELEM_U16, by width.
+ *
+ * There is none for 2^16 counters of 64 bits: they do not fit in
+ * NARROW_CACHE_BYTES, so HISTOGRAM_AUTO counts them with HISTOGRAM_NARROW.
+ */
+static const histogram_kernel full_kernels[ELEM_U16 + 1][2] = {
+    [ELEM_U8]  = {histogram_full_u8_32,  histogram_full_u8_64},
+    [ELEM_U16] = {histogram_full_u16_32, NULL}
+};
+
+/** @brief Kind of elements, in addition to the elem_type values. */
+#define ELEM_RECORD (ELEM_I64 + 1)
+
+/** @brief All the kernels, by kind of element, width and mode. */
+static const histogram_kernel kernels[ELEM_RECORD + 1][2][4] = {
+    [ELEM_U8]     = {{histogram_private_u8_32, histogram_atomic_u8_32,
+                      histogram_narrow8_u8_32, histogram_narrow16_u8_32},
+                     {histogram_private_u8_64, histogram_atomic_u8_64,
+                      histogram_narrow8_u8_64, histogram_narrow16_u8_64}},
+    [ELEM_U16]    = {{histogram_private_u16_32, histogram_atomic_u16_32,
+                      histogram_narrow8_u16_32, histogram_narrow16_u16_32},
+                     {histogram_private_u16_64, histogram_atomic_u16_64,
+                      histogram_narrow8_u16_64, histogram_narrow16_u16_64}},
+    [ELEM_I32]    = {{histogram_private_i32_32, histogram_atomic_i32_32,
+                      histogram_narrow8_i32_32, histogram_narrow16_i32_32},
+                     {histogram_private_i32_64, histogram_atomic_i32_64,
+                      histogram_narrow8_i32_64, histogram_narrow16_i32_64}},
+    [ELEM_I64]    = {{histogram_private_i64_32, histogram_atomic_i64_32,
+                      histogram_narrow8_i64_32, histogram_narrow16_i64_32},
+                     {histogram_private_i64_64, histogram_atomic_i64_64,
+                      histogram_narrow8_i64_64, histogram_narrow16_i64_64}},
+    [ELEM_RECORD] = {{histogram_private_rec_32, histogram_atomic_rec_32,
+                      histogram_narrow8_rec_32, histogram_narrow16_rec_32},
+                     {histogram_private_rec_64, histogram_atomic_rec_64,
+                      histogram_narrow8_rec_64, histogram_narrow16_rec_64}}
+};
+
+/** @brief Signature shared by all the kernels building block histograms. */
+typedef void (*blocks_kernel)(const void *data, long long record_size,
+                              key_extractor extract, long long size,
+                              long long min, void *blocks,
+                              long long count_size, long long nblocks,
+                              int nthreads);
+
+/** @brief All the block histogram kernels, by kind of element and width. */
+static const blocks_kernel block_kernels[ELEM_RECORD + 1][2] = {
+    [ELEM_U8]     = {histogram_blocks_u8_32,  histogram_blocks_u8_64},
+    [ELEM_U16]    = {histogram_blocks_u16_32, histogram_blocks_u16_64},
+    [ELEM_I32]    = {histogram_blocks_i32_32, histogram_blocks_i32_64},
+    [ELEM_I64]    = {histogram_blocks_i64_32, histogram_blocks_i64_64},
+    [ELEM_RECORD] = {histogram_blocks_rec_32, histogram_blocks_rec_64}
+};
+
+
+/**
+ * @brief Pick the kernel to use and run it.
+ *
+ * Same parameters as histogram_kernel, plus the kind of elements, the width of
+ * the counters and the mode.
+ */
+static long long dispatch(int kind, const void *data, long long record_size,
+                          key_extractor extract, long long size, long long min,
+                          void *count, long long count_size, count_width width,
+                          long long *out_min, long long *out_max,
+                          void *scratch, histogram_mode mode, int nthreads)
+{
+    long long item_size = count_item_size(width);
+
+    if (mode == HISTOGRAM_AUTO) {
+        long long nslots = team_size(nthreads);
+        long long per_thread = size / nslots;
+        mode = nslots > 1 && count_size > ATOMIC_RATIO * per_thread
+               ? HISTOGRAM_ATOMIC : HISTOGRAM_PRIVATE;
+        if (mode == HISTOGRAM_PRIVATE &&
+            count_size * item_size > NARROW_CACHE_BYTES)
+            mode = HISTOGRAM_NARROW;
+    }
+
+    /* The whole range of a small type: no key can fall outside of it. */
+    if ((kind == ELEM_U8 || kind == ELEM_U16) && min == 0 &&
+        count_size == (kind == ELEM_U8 ? UINT8_MAX + 1 : UINT16_MAX + 1) &&
+        mode == HISTOGRAM_PRIVATE &&
+        full_kernels[kind][width == COUNT_64] != NULL)
+        return full_kernels[kind][width == COUNT_64](
+            data, record_size, extract, size, min, count, count_size,
+            out_min, out_max, scratch, nthreads);
+
+    /* The widest narrow counters whose private copy still fits in cache. */
+    int column = mode == HISTOGRAM_ATOMIC;
+    if (mode == HISTOGRAM_NARROW)
+        column = count_size * sizeof(uint16_t) <= NARROW_CACHE_BYTES ? 3 : 2;
+
+    histogram_kernel kernel = kernels[kind][width == COUNT_64][column];
+    return kernel(data, record_size, extract, size, min, count, count_size,
+                  out_min, out_max, scratch, nthreads);
+}
+
+
+count_width histogram_width(long long size) {
+    return size > UINT32_MAX ? COUNT_64 : COUNT_32;
+}
+
+
+long long count_item_size(count_width width) {
+    return width == COUNT_64 ? sizeof(uint64_t) : sizeof(uint32_t);
+}
+
+
+long long histogram_scratch_size(long long count_size, count_width width,
+                                 int nthreads)
+{
+    long long item_size = count_item_size(width);
+    long long per_line = CACHE_LINE_SIZE / item_size;
+    long long stride = (count_size + per_line - 1) / per_line * per_line;
+    return item_size * stride * team_size(nthreads);
+}
+
+
+long long histogram_build(const int *array, long long size, int min,
+                          void *count, long long count_size, count_width width,
+                          int *out_min, int *out_max, histogram_mode mode,
+                          int nthreads)
+{
+    return histogram_build_scratch(array, size, min, count, count_size, width,
+                                   out_min, out_max, NULL, mode, nthreads);
+}
+
+
+long long histogram_build_scratch(const int *array, long long size, int min,
+                                  void *count, long long count_size,
+                                  count_width width, int *out_min,
+                                  int *out_max, void *scratch,
+                                  histogram_mode mode, int nthreads)
+{
+    long long lo = 0, hi = 0;
+    long long skipped = dispatch(ELEM_I32, array, 0, NULL, size, min, count,
+                                 count_size, width, &lo, &hi, scratch, mode,
+                                 nthreads);
+
+    if (skipped > 0) {
+        if (out_min != NULL)
+            *out_min = lo;
+        if (out_max != NULL)
+            *out_max = hi;
+    }
+    return skipped;
+}
+
+
+long long histogram_build_typed(const void *array, elem_type type,
+                                long long size, long long min, void *count,
+                                long long count_size, count_width width,
+                                long long *out_min, long long *out_max,
+                                histogram_mode mode, int nthreads)
+{
+    return dispatch(type, array, 0, NULL, size, min, count, count_size, width,
+                    out_min, out_max, NULL, mode, nthreads);
+}
+
+
+long long histogram_build_records(const void *records, long long size,
+                                  long long record_size, key_extractor key,
+                                  long long min, void *count,
+                                  long long count_size, count_width width,
+                                  long long *out_min, long long *out_max,
+                                  histogram_mode mode, int nthreads)
+{
+    return dispatch(ELEM_RECORD, records, record_size, key, size, min, count,
+                    count_size, width, out_min, out_max, NULL, mode,
+                    nthreads);
+}
+
+
+void histogram_blocks_typed(const void *array, elem_type type, long long size,
+                            long long min, void *blocks, long long count_size,
+                            count_width width, long long nblocks, int nthreads)
+{
+    block_kernels[type][width == COUNT_64](array, 0, NULL, size, min, blocks,
+                                           count_size, nblocks, nthreads);
+}
+
+
+void histogram_blocks_records(const void *records, long long size,
+                              long long record_size, key_extractor key,
+                              long long min, void *blocks,
+                              long long count_size, count_width width,
+                              long long nblocks, int nthreads)
+{
+    block_kernels[ELEM_RECORD][width == COUNT_64](records, record_size, key,
+                                                  size, min, blocks,
+                                                  count_size, nblocks,
+                                                  nthreads);
+}
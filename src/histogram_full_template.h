@@ -0,0 +1,125 @@
+/**
+ * @file histogram_full_template.h
+ * @brief This file contains the kernel counting the whole range of a small
+ *        unsigned type, written once for every type and width of the counters.
+ * @author Marco Plaitano
+ * @date 29 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * This file is not a regular header: it is included by histogram.c once per
+ * pair of element and counter types, with these macros defined beforehand:
+ *   COUNT_T:   type of the counters (e.g. uint32_t);
+ *   ELEM_T:    unsigned type of the elements (uint8_t or uint16_t);
+ *   LANES:     number of interleaved copies of the histogram every thread
+ *              counts into;
+ *   FULL_NAME: name of the kernel (e.g. histogram_full_u8_32).
+ */
+
+/** @brief Number of values of ELEM_T, i.e. of buckets of the histogram. */
+#define FULL_SIZE (1LL << (8 * sizeof(ELEM_T)))
+
+
+/**
+ * @brief Build the histogram of all the values of ELEM_T, starting from 0.
+ *
+ * See histogram_kernel for parameters and return value; `min` must be 0 and
+ * `count_size` FULL_SIZE, so no element is ever out of the range.
+ *
+ * Since every element is a valid index, the loop has neither a bound check nor
+ * a subtraction, and the size of the histogram is known at compile time. With
+ * LANES > 1 consecutive elements go to different copies, so that a run of
+ * equal values does not turn every increment into a wait for the previous
+ * one. The copies are then merged as in KERNEL(histogram_private).
+ */
+static long long FULL_NAME(const void *data, long long record_size,
+                           key_extractor extract, long long size,
+                           long long min, void *count_ptr,
+                           long long count_size, long long *out_min,
+                           long long *out_max, void *scratch, int nthreads)
+{
+    const ELEM_T *array = (const ELEM_T *)data;
+    COUNT_T *count = (COUNT_T *)count_ptr;
+    long long nslots = team_size(nthreads);
+    long long ncopies = nslots * LANES;
+
+    /* With a single copy there is nothing to merge: count in place. */
+    COUNT_T *priv = count;
+    if (ncopies > 1)
+        priv = scratch != NULL && LANES == 1
+             ? (COUNT_T *)scratch
+             : (COUNT_T *)safe_aligned_alloc(CACHE_LINE_SIZE,
+                                             sizeof(COUNT_T) * FULL_SIZE *
+                                             ncopies);
+
+    #pragma omp parallel num_threads(nthreads) default(shared)
+    {
+        long long nt = omp_get_num_threads();
+        long long t = omp_get_thread_num();
+        COUNT_T *mine = priv + FULL_SIZE * LANES * t;
+        long long end = BLOCK_BEGIN(size, t + 1, nt);
+        long long b = 0, i = 0, l = 0, s = 0;
+
+        profile_begin(PHASE_ZERO_FILL);
+        for (b = 0; b < FULL_SIZE * LANES; b++)
+            mine[b] = 0;
+        profile_end(PHASE_ZERO_FILL);
+
+        profile_begin(PHASE_HISTOGRAM);
+        for (i = BLOCK_BEGIN(size, t, nt); i + LANES <= end; i += LANES)
+            for (l = 0; l < LANES; l++)
+                mine[FULL_SIZE * l + array[i + l]] += 1;
+        for (; i < end; i++)
+            mine[array[i]] += 1;
+        profile_end(PHASE_HISTOGRAM);
+
+        if (priv != count) {
+            long long nmerge = (FULL_SIZE + MERGE_BLOCK - 1) / MERGE_BLOCK;
+            long long m = 0;
+            #pragma omp barrier
+
+            /* Every iteration sums a block of buckets, across all the copies. */
+            tuning_apply_schedule(LOOP_MERGE);
+            profile_begin(PHASE_MERGE);
+            #pragma omp for schedule(runtime) nowait
+            for (m = 0; m < nmerge; m++) {
+                long long first = m * MERGE_BLOCK;
+                long long last = first + MERGE_BLOCK < FULL_SIZE
+                               ? first + MERGE_BLOCK : FULL_SIZE;
+                for (b = first; b < last; b++)
+                    count[b] = priv[b];
+                for (s = 1; s < nt * LANES; s++)
+                    for (b = first; b < last; b++)
+                        count[b] += priv[FULL_SIZE * s + b];
+            }
+            profile_end(PHASE_MERGE);
+        }
+    }
+
+    if (priv != count && priv != scratch)
+        free(priv);
+    return 0;
+}
+
+
+#undef FULL_SIZE
@@ -0,0 +1,135 @@
+/**
+ * @file histogram_narrow_template.h
+ * @brief This file contains the kernel building a histogram with narrow
+ *        private counters, written once for every width of them.
+ * @author Marco Plaitano
+ * @date 29 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/*
+ * This file is not a regular header: it is included by histogram_template.h
+ * once per width of the narrow counters, with these macros defined, besides
+ * the ones of histogram_template.h:
+ *   NARROW_T:    type of the private counters (uint8_t or uint16_t);
+ *   NARROW_NAME: name of the kernel (e.g. histogram_narrow8).
+ */
+
+
+/**
+ * @brief Build the histogram giving every thread a private copy of it, made
+ *        of counters narrower than the ones of the histogram.
+ *
+ * See histogram_kernel for parameters and return value.
+ *
+ * A private copy of NARROW_T counters takes 2 or 4 times less cache than one
+ * of COUNT_T counters, so a range that would not fit in L2 still does. When a
+ * private counter wraps around to 0, the 2^(8 * sizeof(NARROW_T)) occurrences
+ * it has lost are added to the shared histogram with an atomic operation,
+ * once every that many increments at most. The private copies are summed into
+ * the shared histogram only at the end, as in KERNEL(histogram_private).
+ */
+static long long KERNEL(NARROW_NAME)(const void *data, long long record_size,
+                                     key_extractor extract, long long size,
+                                     long long min, void *count_ptr,
+                                     long long count_size, long long *out_min,
+                                     long long *out_max, void *scratch,
+                                     int nthreads)
+{
+    COUNT_T *count = (COUNT_T *)count_ptr;
+    const COUNT_T spill = (COUNT_T)1 << (8 * sizeof(NARROW_T));
+    long long nslots = team_size(nthreads);
+    long long per_line = CACHE_LINE_SIZE / sizeof(NARROW_T);
+    long long stride = (count_size + per_line - 1) / per_line * per_line;
+    long long skipped = 0;
+    long long lo = LLONG_MAX, hi = LLONG_MIN;
+
+    /* The narrow copies never take more than the scratch of the wide ones. */
+    NARROW_T *priv = scratch != NULL ? (NARROW_T *)scratch
+                                     : (NARROW_T *)safe_aligned_alloc(
+                                           CACHE_LINE_SIZE,
+                                           sizeof(NARROW_T) * stride *
+                                           nslots);
+
+    #pragma omp parallel num_threads(nthreads) default(shared) \
+            reduction(+: skipped) reduction(min: lo) reduction(max: hi)
+    {
+        long long nt = omp_get_num_threads();
+        long long t = omp_get_thread_num();
+        NARROW_T *mine = priv + stride * t;
+        long long b = 0, i = 0, s = 0, m = 0;
+        long long nmerge = (count_size + MERGE_BLOCK - 1) / MERGE_BLOCK;
+
+        profile_begin(PHASE_ZERO_FILL);
+        memset(mine, 0, sizeof(NARROW_T) * count_size);
+        #pragma omp for schedule(static) nowait
+        for (b = 0; b < count_size; b++)
+            count[b] = 0;
+        profile_end(PHASE_ZERO_FILL);
+        /* The spills of a thread can reach buckets zeroed by another one. */
+        #pragma omp barrier
+
+        profile_begin(PHASE_HISTOGRAM);
+        for (i = BLOCK_BEGIN(size, t, nt); i < BLOCK_BEGIN(size, t + 1, nt);
+             i++) {
+            long long k = KEY(i);
+            unsigned long long j = (unsigned long long)k - min;
+            if (j < (unsigned long long)count_size) {
+                if (++mine[j] == 0) {
+                    #pragma omp atomic update
+                    count[j] += spill;
+                }
+            }
+            else {
+                skipped++;
+                lo = k < lo ? k : lo;
+                hi = k > hi ? k : hi;
+            }
+        }
+        profile_end(PHASE_HISTOGRAM);
+        #pragma omp barrier
+
+        tuning_apply_schedule(LOOP_MERGE);
+        profile_begin(PHASE_MERGE);
+        #pragma omp for schedule(runtime) nowait
+        for (m = 0; m < nmerge; m++) {
+            long long first = m * MERGE_BLOCK;
+            long long last = first + MERGE_BLOCK < count_size
+                           ? first + MERGE_BLOCK : count_size;
+            for (s = 0; s < nt; s++)
+                for (b = first; b < last; b++)
+                    count[b] += priv[stride * s + b];
+        }
+        profile_end(PHASE_MERGE);
+    }
+
+    if (priv != scratch)
+        free(priv);
+
+    if (skipped > 0) {
+        if (out_min != NULL)
+            *out_min = lo;
+        if (out_max != NULL)
+            *out_max = hi;
+    }
+    return skipped;
+}
@@ -0,0 +1,250 @@
+/**
+ * @file histogram_template.h
+ * @brief This file contains the kernels building a histogram, written once for
+ *        every type of element and every width of the counters.
+ * @author Marco Plaitano
+ * @date 29 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This file is not a regular header: it is included by histogram.c once per
+ * pair of element and counter types, with these macros defined beforehand:
+ *   COUNT_T:   type of the counters (e.g. uint32_t);
+ *   KEY(i):    expression giving the (long long) key of the i-th element; it
+ *              can refer to the `data`, `record_size` and `extract` parameters
+ *              of the kernels;
+ *   SUFFIX:    suffix appended to the names of the kernels (e.g. i32_32).
+ */
+
+#define KERNEL_NAME_(name, suffix) name##_##suffix
+#define KERNEL_NAME(name, suffix) KERNEL_NAME_(name, suffix)
+#define KERNEL(name) KERNEL_NAME(name, SUFFIX)
+
+
+/**
+ * @brief Build the histogram giving every thread a private copy of it.
+ *
+ * See histogram_kernel for parameters and return value.
+ *
+ * Every private histogram is padded to a whole number of cache lines, so that
+ * no two threads ever write on the same line. Once the counting is done, the
+ * threads merge the copies without any lock: every thread sums different
+ * blocks of buckets (see LOOP_MERGE), across all the copies.
+ */
+static long long KERNEL(histogram_private)(const void *data,
+                                           long long record_size,
+                                           key_extractor extract,
+                                           long long size, long long min,
+                                           void *count_ptr,
+                                           long long count_size,
+                                           long long *out_min,
+                                           long long *out_max, void *scratch,
+                                           int nthreads)
+{
+    COUNT_T *count = (COUNT_T *)count_ptr;
+    long long nslots = team_size(nthreads);
+    long long per_line = CACHE_LINE_SIZE / sizeof(COUNT_T);
+    long long stride = (count_size + per_line - 1) / per_line * per_line;
+    long long skipped = 0;
+    long long lo = LLONG_MAX, hi = LLONG_MIN;
+
+    /* With a single thread there is nothing to merge: count in place. */
+    COUNT_T *priv = count;
+    if (nslots > 1)
+        priv = scratch != NULL ? (COUNT_T *)scratch
+                               : (COUNT_T *)safe_aligned_alloc(
+                                     CACHE_LINE_SIZE,
+                                     sizeof(COUNT_T) * stride * nslots);
+
+    #pragma omp parallel num_threads(nthreads) default(shared) \
+            reduction(+: skipped) reduction(min: lo) reduction(max: hi)
+    {
+        long long nt = omp_get_num_threads();
+        long long t = omp_get_thread_num();
+        COUNT_T *mine = priv + stride * t;
+        long long b = 0, i = 0, s = 0;
+
+        profile_begin(PHASE_ZERO_FILL);
+        for (b = 0; b < count_size; b++)
+            mine[b] = 0;
+        profile_end(PHASE_ZERO_FILL);
+
+        profile_begin(PHASE_HISTOGRAM);
+        for (i = BLOCK_BEGIN(size, t, nt); i < BLOCK_BEGIN(size, t + 1, nt);
+             i++) {
+            long long k = KEY(i);
+            /* Keys below min wrap around to huge (unsigned) indices. */
+            unsigned long long j = (unsigned long long)k - min;
+            if (j < (unsigned long long)count_size)
+                mine[j] += 1;
+            else {
+                skipped++;
+                lo = k < lo ? k : lo;
+                hi = k > hi ? k : hi;
+            }
+        }
+        profile_end(PHASE_HISTOGRAM);
+
+        if (priv != count) {
+            long long nmerge = (count_size + MERGE_BLOCK - 1) / MERGE_BLOCK;
+            long long m = 0;
+            #pragma omp barrier
+
+            /* Every iteration sums a block of buckets, across all the copies. */
+            tuning_apply_schedule(LOOP_MERGE);
+            profile_begin(PHASE_MERGE);
+            #pragma omp for schedule(runtime) nowait
+            for (m = 0; m < nmerge; m++) {
+                long long first = m * MERGE_BLOCK;
+                long long last = first + MERGE_BLOCK < count_size
+                               ? first + MERGE_BLOCK : count_size;
+                for (b = first; b < last; b++)
+                    count[b] = priv[b];
+                for (s = 1; s < nt; s++)
+                    for (b = first; b < last; b++)
+                        count[b] += priv[stride * s + b];
+            }
+            profile_end(PHASE_MERGE);
+        }
+    }
+
+    if (priv != count && priv != scratch)
+        free(priv);
+
+    if (skipped > 0) {
+        if (out_min != NULL)
+            *out_min = lo;
+        if (out_max != NULL)
+            *out_max = hi;
+    }
+    return skipped;
+}
+
+
+/**
+ * @brief Build the histogram with all the threads sharing the same one.
+ *
+ * See histogram_kernel for parameters and return value.
+ *
+ * Worth it when the range is so much larger than the part of the array each
+ * thread counts that initializing and merging private copies would cost more
+ * than the (rarely contended) atomic increments.
+ */
+static long long KERNEL(histogram_atomic)(const void *data,
+                                          long long record_size,
+                                          key_extractor extract,
+                                          long long size, long long min,
+                                          void *count_ptr,
+                                          long long count_size,
+                                          long long *out_min,
+                                          long long *out_max, void *scratch,
+                                          int nthreads)
+{
+    COUNT_T *count = (COUNT_T *)count_ptr;
+    long long i = 0;
+    long long skipped = 0;
+    long long lo = LLONG_MAX, hi = LLONG_MIN;
+
+    #pragma omp parallel num_threads(nthreads) default(shared) private(i) \
+            reduction(+: skipped) reduction(min: lo) reduction(max: hi)
+    {
+        tuning_apply_schedule(LOOP_ZERO_FILL);
+        profile_begin(PHASE_ZERO_FILL);
+        #pragma omp for schedule(runtime) nowait
+        for (i = 0; i < count_size; i++)
+            count[i] = 0;
+        profile_end(PHASE_ZERO_FILL);
+        #pragma omp barrier
+
+        tuning_apply_schedule(LOOP_HISTOGRAM);
+        profile_begin(PHASE_HISTOGRAM);
+        #pragma omp for schedule(runtime) nowait
+        for (i = 0; i < size; i++) {
+            long long k = KEY(i);
+            unsigned long long j = (unsigned long long)k - min;
+            if (j < (unsigned long long)count_size) {
+                #pragma omp atomic update
+                count[j] += 1;
+            }
+            else {
+                skipped++;
+                lo = k < lo ? k : lo;
+                hi = k > hi ? k : hi;
+            }
+        }
+        profile_end(PHASE_HISTOGRAM);
+    }
+
+    if (skipped > 0) {
+        if (out_min != NULL)
+            *out_min = lo;
+        if (out_max != NULL)
+            *out_max = hi;
+    }
+    return skipped;
+}
+
+
+#define NARROW_T uint8_t
+#define NARROW_NAME histogram_narrow8
+#include "histogram_narrow_template.h"
+#undef NARROW_T
+#undef NARROW_NAME
+
+#define NARROW_T uint16_t
+#define NARROW_NAME histogram_narrow16
+#include "histogram_narrow_template.h"
+#undef NARROW_T
+#undef NARROW_NAME
+
+
+/**
+ * @brief Build one histogram for every block of the array, without merging
+ *        them.
+ *
+ * See histogram_blocks_typed() for the meaning of the parameters; `data`,
+ * `record_size` and `extract` are the same as histogram_kernel.
+ */
+static void KERNEL(histogram_blocks)(const void *data, long long record_size,
+                                     key_extractor extract, long long size,
+                                     long long min, void *blocks_ptr,
+                                     long long count_size, long long nblocks,
+                                     int nthreads)
+{
+    COUNT_T *blocks = (COUNT_T *)blocks_ptr;
+    long long t = 0;
+
+    #pragma omp parallel for num_threads(nthreads) default(shared) private(t)
+    for (t = 0; t < nblocks; t++) {
+        COUNT_T *mine = blocks + count_size * t;
+        for (long long b = 0; b < count_size; b++)
+            mine[b] = 0;
+        for (long long i = BLOCK_BEGIN(size, t, nblocks);
+             i < BLOCK_BEGIN(size, t + 1, nblocks); i++)
+            mine[KEY(i) - min] += 1;
+    }
+}
+
+
+#undef KERNEL
+#undef KERNEL_NAME
+#undef KERNEL_NAME_
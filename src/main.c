@@ -25,42 +25,236 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "counting_sort.h"
+#include "offload_sort.h"
+#include "profile.h"
+#include "stream_sort.h"
+#include "tuning.h"
 #include "util.h"
 
 
+/**
+ * @brief Sort a raw binary file of `int`s, mapped in memory.
+ * @param input:       Path to the file to sort.
+ * @param output:      Path to the file to write the sorted values in; if NULL,
+ *                     the input file is sorted in place.
+ * @param num_threads: Number of threads to use.
+ *
+ * No data goes through stdio: the input is sorted in place or read once
+ * through its mapping while the sorted values are written straight into the
+ * mapping of the output. The same CSV line as for generated arrays is
+ * printed, with the time spent mapping the files as `time_init`.
+ */
+static void sort_file(const char *input, const char *output,
+                      int num_threads)
+{
+    long long bytes = 0;
+    int *array = NULL, *sorted = NULL;
+    double time_init = 0;
+    double time_sort = 0;
+
+    START_TIME(time_init);
+    array = file_map(input, &bytes, output == NULL ? FILE_MAP_UPDATE
+                                                   : FILE_MAP_READ);
+    if (bytes % sizeof(int) != 0) {
+        fprintf(stderr, "The size of file '%s' is not a multiple of %zu.\n",
+                input, sizeof(int));
+        exit(EXIT_FAILURE);
+    }
+    if (output != NULL)
+        sorted = file_map(output, &bytes, FILE_MAP_CREATE);
+    END_TIME(time_init);
+
+    const long long size = bytes / sizeof(int);
+    counting_sort_calibrate(num_threads);
+
+    START_TIME(time_sort);
+    if (output == NULL)
+        counting_sort(array, size, num_threads);
+    else
+        counting_sort_copy(array, sorted, size, num_threads);
+    END_TIME(time_sort);
+
+    printf("%lld;%d;%.5f;%.5f;%.5f\n", size, num_threads, time_init, time_sort,
+                                       time_init + time_sort);
+
+    file_unmap(array, bytes);
+    file_unmap(sorted, bytes);
+}
+
+
+/**
+ * @brief Sort a raw binary file of `int`s into another file, streaming both
+ *        through buffers of `chunk_bytes` bytes.
+ * @param input:       Path to the file to sort.
+ * @param output:      Path to the file to write the sorted values in.
+ * @param chunk_bytes: Size of the buffers.
+ * @param num_threads: Number of threads to use.
+ *
+ * The whole sort is timed as `time_sort`; `time_init` is always 0.
+ */
+static void stream_file(const char *input, const char *output,
+                        long long chunk_bytes, int num_threads)
+{
+    double time_sort = 0;
+
+    START_TIME(time_sort);
+    long long size = stream_sort_file(input, output, chunk_bytes,
+                                      num_threads);
+    END_TIME(time_sort);
+
+    printf("%lld;%d;%.5f;%.5f;%.5f\n", size, num_threads, 0.0, time_sort,
+                                       time_sort);
+}
+
+
 int main(int argc, char **argv) {
-    if (argc < 3) {
-        fprintf(stderr, "usage: main.out (int)array_size (int)num_threads\n");
+    /* The array starts where the threads of the sort will read it. */
+    alloc_policy policy = ALLOC_FIRST_TOUCH;
+    /* A fixed default seed makes every run sort the same data. */
+    uint64_t seed = 0;
+    distribution dist = DIST_UNIFORM;
+    int min = RANGE_MIN, max = RANGE_MAX;
+    const char *input = NULL, *output = NULL;
+    long long chunk_bytes = 0;
+    bool offload = false, profile = false, explain = false;
+    thread_affinity affinity = AFFINITY_NONE;
+    const char *tuning_profile = NULL;
+    int opt = 0;
+
+    while ((opt = getopt(argc, argv, "a:c:d:egi:o:pr:s:A:B:S:")) != -1) {
+        if (opt == 'a')
+            policy = alloc_policy_parse(optarg);
+        else if (opt == 'd')
+            dist = distribution_parse(optarg);
+        else if (opt == 'r') {
+            if (sscanf(optarg, "%d:%d", &min, &max) != 2 || min > max) {
+                fprintf(stderr, "Invalid range '%s'.\n", optarg);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (opt == 's')
+            seed = strtoull(optarg, NULL, 10);
+        else if (opt == 'i')
+            input = optarg;
+        else if (opt == 'o')
+            output = optarg;
+        else if (opt == 'c')
+            chunk_bytes = atoll(optarg) << 20;
+        else if (opt == 'e')
+            explain = true;
+        else if (opt == 'g')
+            offload = true;
+        else if (opt == 'p')
+            profile = true;
+        else if (opt == 'A')
+            tuning_profile = optarg;
+        else if (opt == 'B')
+            affinity = affinity_parse(optarg);
+        else if (opt == 'S')
+            schedule_parse(optarg);
+        else
+            argc = 0;
+    }
+
+    /* The number of threads is always the last argument. */
+    if (argc > optind)
+        tuning_set_affinity(affinity, atoi(argv[argc - 1]));
+
+    if (input != NULL && output != NULL && chunk_bytes > 0 &&
+        argc - optind == 1) {
+        stream_file(input, output, chunk_bytes, atoi(argv[optind]));
+        return EXIT_SUCCESS;
+    }
+    if (input != NULL && chunk_bytes == 0 && argc - optind == 1) {
+        sort_file(input, output, atoi(argv[optind]));
+        return EXIT_SUCCESS;
+    }
+
+    if (input != NULL || output != NULL || argc - optind < 2) {
+        fprintf(stderr, "usage: main.out [-a default|first-touch|interleave] "
+                        "[-d uniform|zipf|normal|equal|sorted|reverse|few] "
+                        "[-r min:max] [-s seed] [-e] [-g] [-p] [-A profile] "
+                        "[-B none|compact|spread] [-S loop=kind[,chunk]] "
+                        "(int)array_size (int)num_threads\n"
+                        "       main.out -i input.bin [-o output.bin] "
+                        "(int)num_threads\n"
+                        "       main.out -i input.bin -o output.bin "
+                        "-c chunk_MB (int)num_threads\n");
         return EXIT_FAILURE;
     }
 
-    const long long size = atoll(argv[1]);
-    int num_threads = atoi(argv[2]);
-    int *array = (int *)safe_alloc(size * sizeof(int));
+    const long long size = atoll(argv[optind]);
+    int num_threads = atoi(argv[optind + 1]);
+    int *array = (int *)safe_alloc_policy(size * sizeof(int), policy,
+                                          num_threads);
     double time_init = 0;
     double time_sort = 0;
 
-    /* Fill the array with random values. */
+    /* Fill the array with values from the chosen distribution. */
     START_TIME(time_init);
-    array_init_random(array, size, RANGE_MIN, RANGE_MAX, num_threads);
+    array_init_distribution(array, size, min, max, dist, seed, num_threads);
     END_TIME(time_init);
 
+    /*
+     * With a profile, sort with the number of threads (up to the one given)
+     * found fastest for this size and range, tuning it if it is not known.
+     */
+    if (tuning_profile != NULL && num_threads > 1) {
+        tuning_load_profile(tuning_profile);
+        num_threads = tuning_best_threads(size, min, max, num_threads);
+        tuning_save_profile(tuning_profile);
+    }
+
+    /* Measure the costs the sort relies on, out of the timed section. */
+    counting_sort_calibrate(num_threads);
+    /* The device buffers are reserved out of the timed section, too. */
+    offload_ctx *ctx = NULL;
+    counting_sort_ctx *host_ctx = counting_sort_ctx_create(num_threads);
+    if (offload) {
+        ctx = offload_ctx_create(num_threads);
+        offload_ctx_reserve(ctx, size, (long long)max - min + 1);
+    }
+
     /* Sort the array. */
+    if (profile)
+        profile_start(num_threads);
     START_TIME(time_sort);
-    counting_sort(array, size, num_threads);
+    if (offload)
+        offload_counting_sort(ctx, array, size);
+    else
+        counting_sort_with_ctx(host_ctx, array, size);
     END_TIME(time_sort);
+    if (profile)
+        profile_stop();
 
     /*
      * This is the program's only output; it is meant to be redirected to a CSV
-     * file.
+     * file. With `-p` the measures of every thread and phase follow on the
+     * same line (see profile_print()).
      */
-    printf("%lld;%d;%.5f;%.5f;%.5f\n", size, num_threads, time_init, time_sort,
-                                       time_init + time_sort);
+    printf("%lld;%d;%.5f;%.5f;%.5f", size, num_threads, time_init, time_sort,
+                                     time_init + time_sort);
+    if (profile)
+        profile_print(stdout);
+    printf("\n");
+
+    /* The decision goes to stderr, to keep the CSV on stdout clean. */
+    if (explain && !offload) {
+        const sort_decision *d = counting_sort_ctx_decision(host_ctx);
+        fprintf(stderr, "strategy=%s range=[%lld;%lld] outliers=%lld "
+                        "distinct=%lld\n", strategy_name(d->strategy),
+                d->min, d->max, d->outliers, d->distinct);
+    }
 
-    free(array);
+    counting_sort_ctx_destroy(host_ctx);
+    offload_ctx_destroy(ctx);
+    safe_free_policy(array, size * sizeof(int), policy);
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,417 @@
+/**
+ * @file offload_sort.c
+ * @brief This file contains the functions needed to sort arrays on an
+ *        accelerator (e.g. a GPU), using Counting Sort Algorithm.
+ * @author Marco Plaitano
+ * @date 13 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "offload_sort.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "counting_sort.h"
+#include "util.h"
+
+#ifdef _OPENMP
+    #include <omp.h>
+#else
+    #define omp_get_team_num() 0
+    #define omp_get_num_teams() 1
+#endif
+
+
+/** @brief Number of counters summed by a thread in the first step of the scan. */
+#define SCAN_BLOCK 1024
+
+/** @brief Number of elements of the sorted array written by a thread. */
+#define SCATTER_SLICE 4096
+
+/**
+ * @brief Number of teams counting the array; each one counts a block of at
+ *        most 2^32 - 1 elements, in 32-bit counters.
+ */
+#define OFFLOAD_TEAMS 64
+
+/**
+ * @brief Ratio between the range of the values and the size of the array
+ *        above which the array is sorted on the host instead; as for the
+ *        radix fallback of counting_sort(), scanning the histogram would
+ *        cost more than sorting.
+ */
+#define OFFLOAD_RANGE_RATIO 4
+
+
+struct offload_ctx {
+    /** Device the arrays are sorted on. */
+    int device;
+    /** Number of threads to use when sorting on the host. */
+    int nthreads;
+    /** Copy of the array currently being sorted. */
+    int *array;
+    /** Occurrences of every value. */
+    unsigned long long *count;
+    /** Starting position of every value, plus the size of the array. */
+    long long *offset;
+    /** Sum of the counters of every block of the scan. */
+    long long *sums;
+    /** Number of elements the buffer `array` can hold. */
+    long long array_size;
+    /** Number of values the buffers `count` and `offset` can hold. */
+    long long count_size;
+};
+
+
+/**
+ * @brief Reserve memory on the device.
+ * @param bytes:  Number of bytes to reserve.
+ * @param device: The device.
+ * @return The device pointer; it is only to be dereferenced inside target
+ *         regions.
+ */
+static void *device_alloc(long long bytes, int device) {
+#ifdef _OPENMP
+    void *ptr = omp_target_alloc(bytes, device);
+    if (ptr == NULL) {
+        fprintf(stderr, "Could not reserve %lld bytes on device %d.\n", bytes,
+                device);
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+#else
+    (void)device;
+    return safe_alloc(bytes);
+#endif
+}
+
+
+/**
+ * @brief Release memory reserved with device_alloc().
+ * @param ptr:    The device pointer; it can be NULL.
+ * @param device: The device.
+ */
+static void device_free(void *ptr, int device) {
+#ifdef _OPENMP
+    if (ptr != NULL)
+        omp_target_free(ptr, device);
+#else
+    (void)device;
+    free(ptr);
+#endif
+}
+
+
+/**
+ * @brief Copy an array between the host and the device.
+ * @param dst:     Destination.
+ * @param src:     Source.
+ * @param bytes:   Number of bytes to copy.
+ * @param device:  The device.
+ * @param to_host: `true` if `dst` is in host memory and `src` on the device,
+ *                 `false` the other way around.
+ */
+static void device_copy(void *dst, const void *src, long long bytes,
+                        int device, bool to_host)
+{
+#ifdef _OPENMP
+    int host = omp_get_initial_device();
+    if (omp_target_memcpy(dst, src, bytes, 0, 0, to_host ? host : device,
+                          to_host ? device : host) != 0) {
+        fprintf(stderr, "Could not copy %lld bytes %s device %d.\n", bytes,
+                to_host ? "from" : "to", device);
+        exit(EXIT_FAILURE);
+    }
+#else
+    (void)device;
+    (void)to_host;
+    memcpy(dst, src, bytes);
+#endif
+}
+
+
+void offload_ctx_reserve(offload_ctx *ctx, long long size,
+                         long long count_size)
+{
+    if (size > ctx->array_size) {
+        device_free(ctx->array, ctx->device);
+        ctx->array = (int *)device_alloc(sizeof(int) * size, ctx->device);
+        ctx->array_size = size;
+    }
+    if (count_size > ctx->count_size && count_size <= OFFLOAD_MAX_RANGE) {
+        long long nblocks = (count_size + SCAN_BLOCK - 1) / SCAN_BLOCK;
+        device_free(ctx->count, ctx->device);
+        device_free(ctx->offset, ctx->device);
+        device_free(ctx->sums, ctx->device);
+        ctx->count = (unsigned long long *)device_alloc(
+            sizeof(unsigned long long) * count_size, ctx->device);
+        ctx->offset = (long long *)device_alloc(
+            sizeof(long long) * (count_size + 1), ctx->device);
+        ctx->sums = (long long *)device_alloc(sizeof(long long) * nblocks,
+                                              ctx->device);
+        ctx->count_size = count_size;
+    }
+}
+
+
+offload_ctx *offload_ctx_create(int nthreads) {
+    offload_ctx *ctx = (offload_ctx *)safe_alloc(sizeof(offload_ctx));
+    memset(ctx, 0, sizeof(offload_ctx));
+#ifdef _OPENMP
+    ctx->device = omp_get_default_device();
+#endif
+    ctx->nthreads = nthreads;
+    return ctx;
+}
+
+
+void offload_ctx_destroy(offload_ctx *ctx) {
+    if (ctx == NULL)
+        return;
+    device_free(ctx->array, ctx->device);
+    device_free(ctx->count, ctx->device);
+    device_free(ctx->offset, ctx->device);
+    device_free(ctx->sums, ctx->device);
+    free(ctx);
+}
+
+
+/**
+ * @brief Count the occurrences of every value of the array on the device.
+ * @param array:      The array, on the device.
+ * @param size:       Number of elements of the array.
+ * @param count:      The histogram, on the device (output).
+ * @param count_size: Number of counters of the histogram.
+ * @param min:        Value associated to the first counter.
+ * @param device:     The device.
+ *
+ * When the histogram fits in OFFLOAD_LOCAL_BUCKETS counters, every team
+ * counts its block in a histogram of its own, held in the memory shared by
+ * its threads, and only adds the non-zero counters to the global one: the
+ * atomic updates of the whole array stay in the fast on-chip memory and
+ * contend among the threads of a team only.
+ */
+static void device_histogram(const int *array, long long size,
+                             unsigned long long *count, long long count_size,
+                             int min, int device)
+{
+    long long i = 0, b = 0;
+
+    #pragma omp target teams distribute parallel for device(device) \
+            is_device_ptr(count)
+    for (b = 0; b < count_size; b++)
+        count[b] = 0;
+
+    if (count_size > OFFLOAD_LOCAL_BUCKETS) {
+        #pragma omp target teams distribute parallel for device(device) \
+                is_device_ptr(array, count)
+        for (i = 0; i < size; i++) {
+            #pragma omp atomic update
+            count[array[i] - min]++;
+        }
+        return;
+    }
+
+    long long nteams = size / UINT32_MAX + 1;
+    nteams = nteams > OFFLOAD_TEAMS ? nteams : OFFLOAD_TEAMS;
+
+    #pragma omp target teams num_teams(nteams) device(device) \
+            is_device_ptr(array, count)
+    {
+        unsigned local[OFFLOAD_LOCAL_BUCKETS];
+        long long t = omp_get_team_num(), nt = omp_get_num_teams();
+        long long first = BLOCK_BEGIN(size, t, nt);
+        long long last = BLOCK_BEGIN(size, t + 1, nt);
+        long long j = 0, c = 0;
+
+        #pragma omp parallel for
+        for (c = 0; c < count_size; c++)
+            local[c] = 0;
+
+        #pragma omp parallel for
+        for (j = first; j < last; j++) {
+            #pragma omp atomic update
+            local[array[j] - min]++;
+        }
+
+        #pragma omp parallel for
+        for (c = 0; c < count_size; c++) {
+            if (local[c] > 0) {
+                #pragma omp atomic update
+                count[c] += local[c];
+            }
+        }
+    }
+}
+
+
+/**
+ * @brief Compute the starting position of every value on the device.
+ * @param count:      The histogram, on the device.
+ * @param offset:     Starting positions, on the device (output); it has
+ *                    `count_size + 1` elements, the last one being the size
+ *                    of the array.
+ * @param sums:       Buffer of one element per SCAN_BLOCK counters.
+ * @param count_size: Number of counters of the histogram.
+ * @param device:     The device.
+ *
+ * The exclusive scan is split in three steps: every thread sums a block of
+ * counters, the few block sums are scanned by a single thread, and every
+ * thread scans its block again starting from its sum.
+ */
+static void device_scan(const unsigned long long *count, long long *offset,
+                        long long *sums, long long count_size, int device)
+{
+    long long nblocks = (count_size + SCAN_BLOCK - 1) / SCAN_BLOCK;
+    long long k = 0;
+
+    #pragma omp target teams distribute parallel for device(device) \
+            is_device_ptr(count, sums)
+    for (k = 0; k < nblocks; k++) {
+        long long end = (k + 1) * SCAN_BLOCK;
+        long long sum = 0;
+        end = end < count_size ? end : count_size;
+        for (long long b = k * SCAN_BLOCK; b < end; b++)
+            sum += count[b];
+        sums[k] = sum;
+    }
+
+    #pragma omp target device(device) is_device_ptr(offset, sums)
+    {
+        long long run = 0;
+        for (long long j = 0; j < nblocks; j++) {
+            long long sum = sums[j];
+            sums[j] = run;
+            run += sum;
+        }
+        offset[count_size] = run;
+    }
+
+    #pragma omp target teams distribute parallel for device(device) \
+            is_device_ptr(count, offset, sums)
+    for (k = 0; k < nblocks; k++) {
+        long long end = (k + 1) * SCAN_BLOCK;
+        long long run = sums[k];
+        end = end < count_size ? end : count_size;
+        for (long long b = k * SCAN_BLOCK; b < end; b++) {
+            offset[b] = run;
+            run += count[b];
+        }
+    }
+}
+
+
+/**
+ * @brief Write the sorted array on the device from the starting positions.
+ * @param array:      The array, on the device (output).
+ * @param size:       Number of elements of the array.
+ * @param offset:     Starting positions of the values, on the device.
+ * @param count_size: Number of counters of the histogram.
+ * @param min:        Value associated to the first counter.
+ * @param device:     The device.
+ *
+ * Every thread writes a slice of SCATTER_SLICE consecutive elements: it finds
+ * the value of its first element by binary search in the offsets and then
+ * walks them forward, so the writes of a slice are contiguous and no thread
+ * depends on another.
+ */
+static void device_scatter(int *array, long long size, const long long *offset,
+                           long long count_size, int min, int device)
+{
+    long long nslices = (size + SCATTER_SLICE - 1) / SCATTER_SLICE;
+    long long s = 0;
+
+    #pragma omp target teams distribute parallel for device(device) \
+            is_device_ptr(array, offset)
+    for (s = 0; s < nslices; s++) {
+        long long pos = s * SCATTER_SLICE;
+        long long end = pos + SCATTER_SLICE < size ? pos + SCATTER_SLICE : size;
+        long long lo = 0, hi = count_size - 1;
+
+        /* Last value starting at or before `pos`: the one that holds it. */
+        while (lo < hi) {
+            long long mid = lo + (hi - lo + 1) / 2;
+            if (offset[mid] <= pos)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+        for (; pos < end; pos++) {
+            while (offset[lo + 1] <= pos)
+                lo++;
+            array[pos] = min + (int)lo;
+        }
+    }
+}
+
+
+void offload_counting_sort(offload_ctx *ctx, int *array, long long size) {
+    if (size < 2)
+        return;
+
+    offload_ctx_reserve(ctx, size, 0);
+    int *dev_array = ctx->array;
+    int min = array[0], max = array[0];
+    long long i = 0;
+
+    device_copy(dev_array, array, sizeof(int) * size, ctx->device, false);
+
+    #pragma omp target teams distribute parallel for device(ctx->device) \
+            is_device_ptr(dev_array) map(tofrom: min, max) \
+            reduction(min: min) reduction(max: max)
+    for (i = 0; i < size; i++) {
+        min = dev_array[i] < min ? dev_array[i] : min;
+        max = dev_array[i] > max ? dev_array[i] : max;
+    }
+
+    const long long count_size = (long long)max - min + 1;
+    if (count_size > OFFLOAD_MAX_RANGE ||
+        count_size > OFFLOAD_RANGE_RATIO * size) {
+        counting_sort(array, size, ctx->nthreads);
+        return;
+    }
+
+    offload_ctx_reserve(ctx, size, count_size);
+    device_histogram(dev_array, size, ctx->count, count_size, min,
+                     ctx->device);
+    device_scan(ctx->count, ctx->offset, ctx->sums, count_size, ctx->device);
+    device_scatter(dev_array, size, ctx->offset, count_size, min,
+                   ctx->device);
+
+    device_copy(array, dev_array, sizeof(int) * size, ctx->device, true);
+}
+
+
+void offload_counting_sort_batch(offload_ctx *ctx, int **arrays,
+                                 const long long *sizes, int narrays)
+{
+    long long largest = 0;
+
+    for (int a = 0; a < narrays; a++)
+        largest = sizes[a] > largest ? sizes[a] : largest;
+    offload_ctx_reserve(ctx, largest, 0);
+
+    for (int a = 0; a < narrays; a++)
+        offload_counting_sort(ctx, arrays[a], sizes[a]);
+}
@@ -0,0 +1,235 @@
+/**
+ * @file profile.c
+ * @brief This file contains the functions needed to measure the time (and
+ *        hardware events) spent by every thread in each phase of the sort.
+ * @author Marco Plaitano
+ * @date 13 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "profile.h"
+
+#ifdef _OPENMP
+    #include <omp.h>
+#else
+    #define omp_get_thread_num() 0
+#endif
+
+#ifdef __linux__
+    #include <linux/perf_event.h>
+    #include <sys/syscall.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "histogram.h"
+#include "util.h"
+
+
+/** @brief Hardware events counted for every thread. */
+enum { EVENT_CYCLES, EVENT_LLC_MISSES, NUM_EVENTS };
+
+
+/** @brief Measures of a thread; every thread writes only its own. */
+typedef struct {
+    /** Time every phase was last started at. */
+    double begin[NUM_PHASES];
+    /** Seconds spent in every phase. */
+    double seconds[NUM_PHASES];
+    /** Value of every counter when every phase was last started. */
+    long long begin_events[NUM_PHASES][NUM_EVENTS];
+    /** Events counted in every phase. */
+    long long events[NUM_PHASES][NUM_EVENTS];
+    /** Descriptors of the counters, or -1. */
+    int fd[NUM_EVENTS];
+    /** Keeps the measures of two threads on different cache lines. */
+    char padding[CACHE_LINE_SIZE];
+} thread_profile;
+
+
+/** @brief Measures of every thread; NULL if never started. */
+static thread_profile *threads = NULL;
+
+/** @brief Number of elements of threads[]. */
+static int nslots = 0;
+
+/** @brief `true` between profile_start() and profile_stop(). */
+static bool active = false;
+
+/** @brief `true` if the counters of every thread could be opened. */
+static bool counters = false;
+
+
+/**
+ * @brief Open a counter of the calling thread.
+ * @param event: One of the EVENT_ values.
+ * @return The descriptor of the counter, or -1 if it could not be opened.
+ */
+static int open_counter(int event) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = event == EVENT_CYCLES ? PERF_COUNT_HW_CPU_CYCLES
+                                        : PERF_COUNT_HW_CACHE_MISSES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    /* pid 0 and cpu -1: the calling thread, on whatever CPU it runs. */
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    (void)event;
+    return -1;
+#endif
+}
+
+
+/**
+ * @brief Read the current value of every counter of a thread.
+ * @param tp:     The thread.
+ * @param values: Values of the counters (output); -1 for the ones not open.
+ */
+static void read_counters(const thread_profile *tp, long long *values) {
+    for (int e = 0; e < NUM_EVENTS; e++) {
+        values[e] = -1;
+        if (tp->fd[e] >= 0 &&
+            read(tp->fd[e], &values[e], sizeof(values[e])) !=
+                sizeof(values[e]))
+            values[e] = -1;
+    }
+}
+
+
+/**
+ * @brief Close the counters of every thread.
+ */
+static void close_counters(void) {
+    for (int t = 0; t < nslots; t++) {
+        for (int e = 0; e < NUM_EVENTS; e++) {
+            if (threads[t].fd[e] >= 0)
+                close(threads[t].fd[e]);
+            threads[t].fd[e] = -1;
+        }
+    }
+}
+
+
+void profile_start(int nthreads) {
+    if (threads != NULL) {
+        close_counters();
+        free(threads);
+    }
+
+    nslots = team_size(nthreads);
+    threads = (thread_profile *)safe_aligned_alloc(
+        CACHE_LINE_SIZE, sizeof(thread_profile) * nslots);
+    memset(threads, 0, sizeof(thread_profile) * nslots);
+    for (int t = 0; t < nslots; t++)
+        for (int e = 0; e < NUM_EVENTS; e++)
+            threads[t].fd[e] = -1;
+
+    /*
+     * A counter only follows the thread that opened it, so every thread of
+     * the team opens its own. OpenMP keeps the same threads from one parallel
+     * region to the next, so the ones of the sort are the ones counted here.
+     */
+    bool all = true;
+    #pragma omp parallel num_threads(nthreads) reduction(&&: all)
+    {
+        int t = omp_get_thread_num();
+        for (int e = 0; e < NUM_EVENTS; e++) {
+            threads[t].fd[e] = open_counter(e);
+            all = all && threads[t].fd[e] >= 0;
+        }
+    }
+    counters = all;
+    if (!counters)
+        close_counters();
+
+    active = true;
+}
+
+
+void profile_stop(void) {
+    active = false;
+    close_counters();
+}
+
+
+void profile_begin(phase p) {
+    int t = omp_get_thread_num();
+    if (!active || t >= nslots)
+        return;
+
+    thread_profile *tp = &threads[t];
+    if (counters)
+        read_counters(tp, tp->begin_events[p]);
+    tp->begin[p] = monotonic_time();
+}
+
+
+void profile_end(phase p) {
+    int t = omp_get_thread_num();
+    if (!active || t >= nslots)
+        return;
+
+    thread_profile *tp = &threads[t];
+    tp->seconds[p] += monotonic_time() - tp->begin[p];
+    if (counters) {
+        long long values[NUM_EVENTS];
+        read_counters(tp, values);
+        for (int e = 0; e < NUM_EVENTS; e++)
+            tp->events[p][e] += values[e] - tp->begin_events[p][e];
+    }
+}
+
+
+double profile_seconds(phase p, int thread) {
+    return thread < nslots ? threads[thread].seconds[p] : 0;
+}
+
+
+bool profile_has_counters(void) {
+    return counters;
+}
+
+
+const char *phase_name(phase p) {
+    static const char *names[NUM_PHASES] = {
+        "min_max", "zero_fill", "histogram", "merge", "scatter"
+    };
+    return names[p];
+}
+
+
+void profile_print(FILE *out) {
+    for (int t = 0; t < nslots; t++) {
+        for (int p = 0; p < NUM_PHASES; p++) {
+            const long long *events = threads[t].events[p];
+            fprintf(out, ";%.6f;%lld;%lld", threads[t].seconds[p],
+                    counters ? events[EVENT_CYCLES] : -1,
+                    counters ? events[EVENT_LLC_MISSES] * CACHE_LINE_SIZE
+                             : -1);
+        }
+    }
+}
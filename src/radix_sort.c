@@ -0,0 +1,128 @@
+/**
+ * @file radix_sort.c
+ * @brief This file contains the LSD Radix Sort Algorithm.
+ * @author Marco Plaitano
+ * @date 29 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "radix_sort.h"
+
+#include <stdlib.h>
+
+#include "util.h"
+
+/** @brief Mask selecting the lowest digit of an integer. */
+#define RADIX_MASK (RADIX_BUCKETS - 1)
+
+
+/**
+ * @brief Return a digit of the item.
+ * @param item:  The item.
+ * @param shift: Position of the lowest bit of the digit.
+ * @return The digit.
+ *
+ * The sign bit is flipped so that negative numbers come before the positive
+ * ones when the digits are compared as unsigned integers.
+ */
+static inline unsigned digit(int item, int shift) {
+    return (((unsigned)item ^ 0x80000000u) >> shift) & RADIX_MASK;
+}
+
+
+void radix_sort(int *array, long long size, int nthreads) {
+    /* Resolved once, so that the workspace fits the blocks of every pass. */
+    nthreads = team_size(nthreads);
+    long long nblocks = nthreads;
+    int *buffer = (int *)safe_alloc(sizeof(int) * size);
+    long long *offset = (long long *)safe_alloc(sizeof(long long) *
+                                                RADIX_BUCKETS * nblocks);
+
+    radix_sort_workspace(array, size, buffer, offset, nthreads);
+
+    free(offset);
+    free(buffer);
+}
+
+
+void radix_sort_workspace(int *array, long long size, int *buffer,
+                          long long *offset, int nthreads)
+{
+    long long nblocks = team_size(nthreads);
+    int *src = array, *dst = buffer;
+    long long i = 0, t = 0;
+
+    for (int shift = 0; shift < 32; shift += RADIX_BITS) {
+        /* Count the occurrences of every digit, block by block. */
+        #pragma omp parallel for num_threads(nthreads) default(shared) \
+                private(t)
+        for (t = 0; t < nblocks; t++) {
+            long long *mine = offset + RADIX_BUCKETS * t;
+            for (long long d = 0; d < RADIX_BUCKETS; d++)
+                mine[d] = 0;
+            for (long long j = BLOCK_BEGIN(size, t, nblocks);
+                 j < BLOCK_BEGIN(size, t + 1, nblocks); j++)
+                mine[digit(src[j], shift)] += 1;
+        }
+
+        /*
+         * Turn the occurrences into positions, ordered by digit first and by
+         * block second, so that every pass is stable. If all the elements
+         * share the same digit, the pass would not move anything.
+         */
+        long long sum = 0;
+        int same_digit = 0;
+        for (long long d = 0; d < RADIX_BUCKETS; d++) {
+            long long digit_total = 0;
+            for (t = 0; t < nblocks; t++) {
+                long long occurrences = offset[RADIX_BUCKETS * t + d];
+                offset[RADIX_BUCKETS * t + d] = sum;
+                sum += occurrences;
+                digit_total += occurrences;
+            }
+            same_digit = same_digit || digit_total == size;
+        }
+        if (same_digit)
+            continue;
+
+        /* Every thread moves its own block to the positions computed. */
+        #pragma omp parallel for num_threads(nthreads) default(shared) \
+                private(t)
+        for (t = 0; t < nblocks; t++) {
+            long long *mine = offset + RADIX_BUCKETS * t;
+            for (long long j = BLOCK_BEGIN(size, t, nblocks);
+                 j < BLOCK_BEGIN(size, t + 1, nblocks); j++)
+                dst[mine[digit(src[j], shift)]++] = src[j];
+        }
+
+        int *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    /* After an odd number of passes the result is in the auxiliary buffer. */
+    if (src != array) {
+        #pragma omp parallel for num_threads(nthreads) default(shared) \
+                private(i)
+        for (i = 0; i < size; i++)
+            array[i] = src[i];
+    }
+}
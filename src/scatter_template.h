@@ -0,0 +1,234 @@
+/**
+ * @file scatter_template.h
+ * @brief This file contains the kernel writing the sorted values back into the
+ *        array, written once for every type of element.
+ * @author Marco Plaitano
+ * @date 29 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * This file is not a regular header: it is included by counting_sort.c once
+ * per element type, with these macros defined beforehand:
+ *   ELEM_T: type of the elements (e.g. int32_t);
+ *   SUFFIX: suffix appended to the name of the kernel (e.g. i32).
+ */
+
+#define KERNEL_NAME_(name, suffix) name##_##suffix
+#define KERNEL_NAME(name, suffix) KERNEL_NAME_(name, suffix)
+#define KERNEL(name) KERNEL_NAME(name, SUFFIX)
+
+
+#ifdef SIMD_BYTES
+/** @brief Return a vector with every lane set to `value`. */
+static inline simd_vector KERNEL(broadcast)(ELEM_T value) {
+    switch (sizeof(ELEM_T)) {
+    case 1:
+        return simd_set1_8(value);
+    case 2:
+        return simd_set1_16(value);
+    case 4:
+        return simd_set1_32(value);
+    default:
+        return simd_set1_64(value);
+    }
+}
+#endif
+
+
+/**
+ * @brief Fill the positions [pos; run_end) of the array with `value`.
+ * @param array:   The array.
+ * @param pos:     First position of the run.
+ * @param run_end: Position right after the run.
+ * @param end:     Position up to which the array may be written; the
+ *                 positions in [run_end; end) must be overwritten afterwards.
+ * @param value:   The value.
+ *
+ * Runs of at least one vector are filled with wide stores, the last of which
+ * overlaps the previous one instead of leaving a scalar tail (or with
+ * memset() for byte-wide types). Shorter runs are covered by a single vector
+ * store that spills into the following positions, which the next runs
+ * rewrite, so that heavily duplicated data does not take a branch per
+ * element; only near `end` the scalar loop is needed.
+ */
+static inline void KERNEL(fill_run)(ELEM_T *array, long long pos,
+                                    long long run_end, long long end,
+                                    ELEM_T value)
+{
+    if (pos >= run_end)
+        return;
+#ifdef SIMD_BYTES
+    const long long lanes = SIMD_BYTES / sizeof(ELEM_T);
+
+    if (run_end - pos >= lanes) {
+        if (sizeof(ELEM_T) == 1) {
+            memset(array + pos, value, run_end - pos);
+            return;
+        }
+        simd_vector v = KERNEL(broadcast)(value);
+        for (; pos + lanes < run_end; pos += lanes)
+            simd_store(array + pos, v);
+        simd_store(array + run_end - lanes, v);
+        return;
+    }
+    if (pos + lanes <= end) {
+        simd_store(array + pos, KERNEL(broadcast)(value));
+        return;
+    }
+#else
+    (void)end;
+    if (sizeof(ELEM_T) == 1) {
+        memset(array + pos, value, run_end - pos);
+        return;
+    }
+#endif
+    for (; pos < run_end; pos++)
+        array[pos] = value;
+}
+
+
+#ifdef SIMD_BYTES
+/**
+ * @brief Fill a slice of the output bypassing the cache.
+ * @param array:  The array.
+ * @param pos:    First position of the slice.
+ * @param end:    Position right after the slice.
+ * @param offset: Starting positions computed by counting_sort_offsets().
+ * @param b:      Bucket of the value position `pos` starts with.
+ * @param min:    Minimum value in the array.
+ *
+ * Only the elements before the first aligned vector and after the last one
+ * are written with regular stores; every vector in between is written with a
+ * non-temporal store, which does not read the destination line beforehand.
+ * Vectors inside a run store the broadcast value, while the ones spanning
+ * the end of a run are assembled element by element, so that no line is
+ * ever written partly from the cache and partly around it.
+ */
+static void KERNEL(scatter_stream)(ELEM_T *array, long long pos,
+                                   long long end, const long long *offset,
+                                   long long b, long long min)
+{
+    const long long lanes = SIMD_BYTES / sizeof(ELEM_T);
+    ELEM_T pattern[SIMD_BYTES / sizeof(ELEM_T)];
+
+    for (; pos < end && (uintptr_t)(array + pos) % SIMD_BYTES != 0;
+         pos++) {
+        while (offset[b + 1] <= pos)
+            b++;
+        array[pos] = (ELEM_T)(min + b);
+    }
+
+    while (pos + lanes <= end) {
+        while (offset[b + 1] <= pos)
+            b++;
+
+        if (offset[b + 1] >= pos + lanes) {
+            long long run_end = offset[b + 1] < end ? offset[b + 1] : end;
+            simd_vector v = KERNEL(broadcast)((ELEM_T)(min + b));
+            for (; pos + lanes <= run_end; pos += lanes)
+                simd_stream(array + pos, v);
+        }
+        else {
+            for (long long l = 0; l < lanes; l++) {
+                while (offset[b + 1] <= pos + l)
+                    b++;
+                pattern[l] = (ELEM_T)(min + b);
+            }
+            simd_stream(array + pos, simd_load(pattern));
+            pos += lanes;
+        }
+    }
+
+    for (; pos < end; pos++) {
+        while (offset[b + 1] <= pos)
+            b++;
+        array[pos] = (ELEM_T)(min + b);
+    }
+
+    /* Make the non-temporal stores visible before the threads join. */
+    _mm_sfence();
+}
+#endif
+
+
+/**
+ * @brief Write back the sorted values into the array.
+ * @param array:      The array.
+ * @param size:       Number of elements stored in the array.
+ * @param offset:     Starting positions computed by counting_sort_offsets().
+ * @param count_size: Number of values in the range.
+ * @param min:        Minimum value in the array.
+ * @param nthreads:   Number of threads to use when OpenMP parallelization is
+ *                    enabled.
+ *
+ * The output is split into slices of (almost) the same size, one per thread
+ * (or SCATTER_SLICES per thread, see LOOP_SCATTER); each thread looks up the
+ * value its slice starts with and fills it on its own, so no thread depends
+ * on the positions written by the others.
+ * Arrays larger than STREAM_MIN_BYTES are not read back while sorting, so
+ * their slices are filled with non-temporal stores (see scatter_stream).
+ */
+static void KERNEL(scatter)(ELEM_T *array, long long size,
+                            const long long *offset, long long count_size,
+                            long long min, int nthreads)
+{
+    long long nslices = team_size(nthreads);
+    long long t = 0;
+    if (tuning_custom_schedule(LOOP_SCATTER))
+        nslices *= SCATTER_SLICES;
+#ifdef SIMD_BYTES
+    bool stream = size * (long long)sizeof(ELEM_T) >= STREAM_MIN_BYTES;
+#endif
+
+    saved_schedule saved = tuning_apply_schedule(LOOP_SCATTER);
+    #pragma omp parallel for num_threads(nthreads) default(shared) private(t) \
+            schedule(runtime)
+    for (t = 0; t < nslices; t++) {
+        long long pos = BLOCK_BEGIN(size, t, nslices);
+        long long end = BLOCK_BEGIN(size, t + 1, nslices);
+        if (pos >= end)
+            continue;
+
+        profile_begin(PHASE_SCATTER);
+        long long b = find_bucket(offset, count_size, pos);
+#ifdef SIMD_BYTES
+        if (stream) {
+            KERNEL(scatter_stream)(array, pos, end, offset, b, min);
+            profile_end(PHASE_SCATTER);
+            continue;
+        }
+#endif
+        while (pos < end) {
+            long long run_end = offset[b + 1] < end ? offset[b + 1] : end;
+            KERNEL(fill_run)(array, pos, run_end, end, (ELEM_T)(min + b));
+            pos = run_end;
+            b++;
+        }
+        profile_end(PHASE_SCATTER);
+    }
+    tuning_restore_schedule(saved);
+}
+
+
+#undef KERNEL
+#undef KERNEL_NAME
+#undef KERNEL_NAME_
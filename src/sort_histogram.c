@@ -0,0 +1,324 @@
+/**
+ * @file sort_histogram.c
+ * @brief This file contains a histogram kept across many batches of values,
+ *        from which their sorted sequence, or part of it, can be generated.
+ * @author Marco Plaitano
+ * @date 13 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sort_histogram.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "counting_sort.h"
+#include "histogram.h"
+#include "util.h"
+
+/**
+ * @brief Minimum ratio between the range of the histogram and the size of a
+ *        batch for the batch to be counted by a single thread, directly into
+ *        the histogram.
+ */
+#define DIRECT_RANGE_RATIO 4
+
+
+struct sort_histogram {
+    /** Occurrences of every value. */
+    uint64_t *total;
+    /** Occurrences of every value in the batch being counted. */
+    uint32_t *batch;
+    /** Starting positions of the values in the sorted sequence. */
+    long long *offset;
+    /** Number of counters in the histograms; 0 before the first value. */
+    long long size;
+    /** Value associated to the first counter. */
+    int min;
+    /** Number of values counted, with all their occurrences. */
+    long long count;
+    /** `false` if the values changed after `offset` was computed. */
+    bool offset_valid;
+    /** Number of threads to use when OpenMP parallelization is enabled. */
+    int nthreads;
+};
+
+
+sort_histogram *sort_histogram_create(int nthreads) {
+    sort_histogram *hist = (sort_histogram *)safe_alloc(sizeof(sort_histogram));
+    hist->total = NULL;
+    hist->batch = NULL;
+    hist->offset = NULL;
+    hist->size = hist->count = 0;
+    hist->min = 0;
+    hist->offset_valid = false;
+    hist->nthreads = nthreads;
+    return hist;
+}
+
+
+void sort_histogram_destroy(sort_histogram *hist) {
+    if (hist == NULL)
+        return;
+    free(hist->total);
+    free(hist->batch);
+    free(hist->offset);
+    free(hist);
+}
+
+
+/**
+ * @brief Widen the range of the histogram to include [lo; hi], keeping the
+ *        occurrences counted so far.
+ * @param hist: The histogram.
+ * @param lo:   Minimum value to include.
+ * @param hi:   Maximum value to include.
+ */
+static void grow(sort_histogram *hist, int lo, int hi) {
+    long long old_max = (long long)hist->min + hist->size - 1;
+    long long min = hist->size > 0 && hist->min < lo ? hist->min : lo;
+    long long max = hist->size > 0 && old_max > hi ? old_max : hi;
+    long long size = max - min + 1;
+
+    if (hist->size > 0 && min == hist->min && size == hist->size)
+        return;
+    if (size > HISTOGRAM_MAX_RANGE) {
+        fprintf(stderr, "The range of the values [%lld, %lld] is too wide "
+                        "for a histogram.\n", min, max);
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t *total = (uint64_t *)safe_alloc(sizeof(uint64_t) * size);
+    memset(total, 0, sizeof(uint64_t) * size);
+    if (hist->size > 0)
+        memcpy(total + (hist->min - min), hist->total,
+               sizeof(uint64_t) * hist->size);
+
+    free(hist->total);
+    free(hist->batch);
+    free(hist->offset);
+    hist->total = total;
+    hist->batch = NULL;
+    hist->offset = NULL;
+    hist->size = size;
+    hist->min = min;
+    hist->offset_valid = false;
+}
+
+
+/**
+ * @brief Tell whether a batch is small enough to be counted by a single
+ *        thread, directly into the histogram.
+ * @param hist: The histogram.
+ * @param size: Number of values in the batch.
+ * @return `true` if going through the whole range would cost more than
+ *         counting the batch serially.
+ */
+static bool count_directly(const sort_histogram *hist, long long size) {
+    return size * DIRECT_RANGE_RATIO < hist->size || size > UINT32_MAX;
+}
+
+
+/**
+ * @brief Count a batch into the histogram of the batch, widening the range
+ *        of the histogram until it holds every value.
+ * @param hist:  The histogram.
+ * @param batch: The values.
+ * @param size:  Number of values in the batch; less than 2^32.
+ * @param grows: `true` to widen the range, `false` to exit the program if
+ *               some values are out of it.
+ *
+ * The batch is counted within the current range; when some values fall out
+ * of it, the range is widened and the batch counted again, which for keys in
+ * a small range only happens on the first batches.
+ */
+static void count_batch(sort_histogram *hist, const int *batch,
+                        long long size, bool grows)
+{
+    int lo = 0, hi = 0;
+
+    for (;;) {
+        if (hist->batch == NULL)
+            hist->batch = (uint32_t *)safe_alloc(sizeof(uint32_t) *
+                                                 hist->size);
+        if (histogram_build(batch, size, hist->min, hist->batch, hist->size,
+                            COUNT_32, &lo, &hi, HISTOGRAM_AUTO,
+                            hist->nthreads) == 0)
+            return;
+        if (!grows) {
+            fprintf(stderr, "Value %d is not in the histogram.\n",
+                    lo < hist->min ? lo : hi);
+            exit(EXIT_FAILURE);
+        }
+        grow(hist, lo, hi);
+    }
+}
+
+
+/**
+ * @brief Add the histogram of the batch to the histogram, or subtract it.
+ * @param hist: The histogram.
+ * @param sign: 1 to add the values, -1 to take them out.
+ * @return `true` if some values were taken out more times than they were in.
+ */
+static bool merge_batch(sort_histogram *hist, int sign) {
+    bool underflow = false;
+    long long b = 0;
+
+    #pragma omp parallel for num_threads(hist->nthreads) shared(hist) \
+            private(b) reduction(||: underflow) schedule(static)
+    for (b = 0; b < hist->size; b++) {
+        underflow = underflow || (sign < 0 && hist->total[b] < hist->batch[b]);
+        hist->total[b] += sign * (int64_t)hist->batch[b];
+    }
+    return underflow;
+}
+
+
+void sort_histogram_add(sort_histogram *hist, const int *batch,
+                        long long size)
+{
+    if (size < 1)
+        return;
+    if (hist->size == 0)
+        grow(hist, batch[0], batch[0]);
+
+    if (count_directly(hist, size)) {
+        int lo = batch[0], hi = batch[0];
+        for (long long i = 1; i < size; i++) {
+            lo = batch[i] < lo ? batch[i] : lo;
+            hi = batch[i] > hi ? batch[i] : hi;
+        }
+        grow(hist, lo, hi);
+        for (long long i = 0; i < size; i++)
+            hist->total[batch[i] - hist->min] += 1;
+    }
+    else {
+        count_batch(hist, batch, size, true);
+        merge_batch(hist, 1);
+    }
+
+    hist->count += size;
+    hist->offset_valid = false;
+}
+
+
+void sort_histogram_remove(sort_histogram *hist, const int *batch,
+                           long long size)
+{
+    long long max = (long long)hist->min + hist->size - 1;
+    bool underflow = false;
+
+    if (size < 1)
+        return;
+    if (hist->size == 0) {
+        fprintf(stderr, "Value %d is not in the histogram.\n", batch[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (count_directly(hist, size)) {
+        for (long long i = 0; i < size && !underflow; i++) {
+            if (batch[i] < hist->min || batch[i] > max) {
+                fprintf(stderr, "Value %d is not in the histogram.\n",
+                        batch[i]);
+                exit(EXIT_FAILURE);
+            }
+            uint64_t *c = &hist->total[batch[i] - hist->min];
+            underflow = *c == 0;
+            *c -= !underflow;
+        }
+    }
+    else {
+        count_batch(hist, batch, size, false);
+        underflow = merge_batch(hist, -1);
+    }
+
+    if (underflow) {
+        fprintf(stderr, "Some values were removed from the histogram more "
+                        "times than they were added.\n");
+        exit(EXIT_FAILURE);
+    }
+    hist->count -= size;
+    hist->offset_valid = false;
+}
+
+
+void sort_histogram_merge(sort_histogram *dst, const sort_histogram *src) {
+    long long b = 0;
+
+    if (src->size == 0)
+        return;
+
+    grow(dst, src->min, src->min + src->size - 1);
+    uint64_t *total = dst->total + (src->min - dst->min);
+
+    #pragma omp parallel for num_threads(dst->nthreads) shared(src, total) \
+            private(b) schedule(static)
+    for (b = 0; b < src->size; b++)
+        total[b] += src->total[b];
+
+    dst->count += src->count;
+    dst->offset_valid = false;
+}
+
+
+long long sort_histogram_size(const sort_histogram *hist) {
+    return hist->count;
+}
+
+
+void sort_histogram_materialize(sort_histogram *hist, int *out) {
+    sort_histogram_materialize_range(hist, out, 0, hist->count);
+}
+
+
+void sort_histogram_materialize_range(sort_histogram *hist, int *out,
+                                      long long first, long long last)
+{
+    if (first < 0 || last > hist->count || first > last) {
+        fprintf(stderr, "Invalid slice [%lld, %lld) of %lld values.\n", first,
+                last, hist->count);
+        exit(EXIT_FAILURE);
+    }
+    if (first == last)
+        return;
+
+    if (!hist->offset_valid) {
+        if (hist->offset == NULL)
+            hist->offset = (long long *)safe_alloc(sizeof(long long) *
+                                                   (hist->size + 1));
+        hist->offset[0] = 0;
+        for (long long b = 0; b < hist->size; b++)
+            hist->offset[b + 1] = hist->offset[b] + hist->total[b];
+        hist->offset_valid = true;
+    }
+
+    counting_sort_fill(out, first, last - first, hist->offset, hist->size,
+                       hist->min, hist->nthreads);
+}
+
+
+void sort_histogram_top(sort_histogram *hist, int *out, long long k) {
+    sort_histogram_materialize_range(hist, out, hist->count - k, hist->count);
+}
@@ -0,0 +1,239 @@
+/**
+ * @file sparse_sort.c
+ * @brief This file contains a Counting Sort based on hash tables, for arrays
+ *        with few distinct values.
+ * @author Marco Plaitano
+ * @date 29 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sparse_sort.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "util.h"
+
+/** @brief Number of elements looked at by estimate_distinct(). */
+#define DISTINCT_SAMPLE_SIZE 4096
+
+/** @brief log2 of the initial number of slots of every hash table. */
+#define TABLE_MIN_BITS 10
+
+
+/** @brief Open-addressing hash table mapping values to their occurrences. */
+typedef struct {
+    /** Value stored in every slot. */
+    int *keys;
+    /** Occurrences of the value in every slot; 0 marks an empty slot. */
+    long long *counts;
+    /** Number of slots; always a power of 2. */
+    long long capacity;
+    /** Number of slots in use. */
+    long long used;
+    /** log2(capacity). */
+    int bits;
+} hash_table;
+
+
+/**
+ * @brief Return the slot in which to start looking for the given value.
+ * @param table: The hash table.
+ * @param key:   The value.
+ * @return Index of the slot.
+ *
+ * Fibonacci hashing: the multiplication mixes all the bits of the value into
+ * the highest ones, which are kept.
+ */
+static inline long long table_slot(const hash_table *table, int key) {
+    return ((uint64_t)(unsigned)key * 0x9E3779B97F4A7C15ull) >>
+           (64 - table->bits);
+}
+
+
+/**
+ * @brief Initialize an empty hash table.
+ * @param table: The hash table.
+ * @param bits:  log2 of the number of slots.
+ */
+static void table_init(hash_table *table, int bits) {
+    table->bits = bits;
+    table->capacity = 1LL << bits;
+    table->used = 0;
+    table->keys = (int *)safe_alloc(sizeof(int) * table->capacity);
+    table->counts = (long long *)safe_alloc(sizeof(long long) *
+                                            table->capacity);
+    for (long long i = 0; i < table->capacity; i++)
+        table->counts[i] = 0;
+}
+
+
+/**
+ * @brief Add `amount` occurrences of the given value to the table.
+ * @param table:  The hash table.
+ * @param key:    The value.
+ * @param amount: Number of occurrences to add; must be positive.
+ */
+static void table_add(hash_table *table, int key, long long amount);
+
+
+/**
+ * @brief Double the number of slots of the table, moving all the values.
+ * @param table: The hash table.
+ */
+static void table_grow(hash_table *table) {
+    hash_table old = *table;
+    table_init(table, old.bits + 1);
+    for (long long i = 0; i < old.capacity; i++)
+        if (old.counts[i] > 0)
+            table_add(table, old.keys[i], old.counts[i]);
+    free(old.keys);
+    free(old.counts);
+}
+
+
+static void table_add(hash_table *table, int key, long long amount) {
+    long long mask = table->capacity - 1;
+    long long i = table_slot(table, key);
+
+    /* Linear probing. */
+    while (table->counts[i] > 0 && table->keys[i] != key)
+        i = (i + 1) & mask;
+
+    if (table->counts[i] == 0) {
+        table->keys[i] = key;
+        table->used++;
+    }
+    table->counts[i] += amount;
+
+    /* Keep the load factor below 1/2, for short probe sequences. */
+    if (table->used * 2 > table->capacity)
+        table_grow(table);
+}
+
+
+/** @brief A distinct value with its occurrences. */
+typedef struct {
+    int key;
+    long long count;
+} entry;
+
+
+/** @brief Compare two entries by value; to be used with qsort(). */
+static int entry_compare(const void *a, const void *b) {
+    int x = ((const entry *)a)->key, y = ((const entry *)b)->key;
+    return (x > y) - (x < y);
+}
+
+
+long long estimate_distinct(const int *array, long long size) {
+    long long nsamples = size < DISTINCT_SAMPLE_SIZE ? size
+                                                     : DISTINCT_SAMPLE_SIZE;
+    long long stride = size / nsamples;
+    long long singles = 0, doubles = 0;
+    hash_table table;
+
+    table_init(&table, TABLE_MIN_BITS);
+    for (long long i = 0; i < nsamples; i++)
+        table_add(&table, array[i * stride], 1);
+    long long distinct = table.used;
+    for (long long i = 0; i < table.capacity; i++) {
+        singles += table.counts[i] == 1;
+        doubles += table.counts[i] == 2;
+    }
+    free(table.keys);
+    free(table.counts);
+
+    /* The whole array has been looked at: the count is exact. */
+    if (nsamples == size)
+        return distinct;
+
+    /*
+     * Chao1 estimator: the values seen only once or twice in the sample hint
+     * at how many have not been seen at all.
+     */
+    if (doubles > 0)
+        distinct += singles * singles / (2 * doubles);
+    else
+        distinct += singles * (singles - 1) / 2;
+    return distinct < size ? distinct : size;
+}
+
+
+void sparse_sort(int *array, long long size, int nthreads) {
+    long long nblocks = team_size(nthreads);
+    hash_table *tables = (hash_table *)safe_alloc(sizeof(hash_table) *
+                                                  nblocks);
+    long long t = 0, d = 0;
+
+    /* Every thread counts its own block in its own table. */
+    #pragma omp parallel for num_threads(nthreads) default(shared) private(t)
+    for (t = 0; t < nblocks; t++) {
+        table_init(&tables[t], TABLE_MIN_BITS);
+        for (long long i = BLOCK_BEGIN(size, t, nblocks);
+             i < BLOCK_BEGIN(size, t + 1, nblocks); i++)
+            table_add(&tables[t], array[i], 1);
+    }
+
+    /*
+     * Merge all the tables into the first one; the work is proportional to
+     * the number of distinct values, not to the size of the array.
+     */
+    hash_table *merged = &tables[0];
+    for (t = 1; t < nblocks; t++) {
+        for (long long i = 0; i < tables[t].capacity; i++)
+            if (tables[t].counts[i] > 0)
+                table_add(merged, tables[t].keys[i], tables[t].counts[i]);
+        free(tables[t].keys);
+        free(tables[t].counts);
+    }
+
+    /* Sort the distinct values only. */
+    long long ndistinct = merged->used;
+    entry *entries = (entry *)safe_alloc(sizeof(entry) * ndistinct);
+    for (long long i = 0, j = 0; i < merged->capacity; i++)
+        if (merged->counts[i] > 0) {
+            entries[j].key = merged->keys[i];
+            entries[j].count = merged->counts[i];
+            j++;
+        }
+    free(merged->keys);
+    free(merged->counts);
+    free(tables);
+    qsort(entries, ndistinct, sizeof(entry), entry_compare);
+
+    /* Expand every value into its run, the runs being independent. */
+    long long *offset = (long long *)safe_alloc(sizeof(long long) * ndistinct);
+    long long sum = 0;
+    for (d = 0; d < ndistinct; d++) {
+        offset[d] = sum;
+        sum += entries[d].count;
+    }
+
+    #pragma omp parallel for num_threads(nthreads) default(shared) private(d) \
+            schedule(dynamic, 64)
+    for (d = 0; d < ndistinct; d++)
+        for (long long i = offset[d]; i < offset[d] + entries[d].count; i++)
+            array[i] = entries[d].key;
+
+    free(offset);
+    free(entries);
+}
@@ -0,0 +1,157 @@
+/**
+ * @file stream_sort.c
+ * @brief This file contains the functions needed to sort files larger than
+ *        the memory, using Counting Sort Algorithm.
+ * @author Marco Plaitano
+ * @date 13 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "stream_sort.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sort_histogram.h"
+#include "util.h"
+
+
+/** @brief Transfer of a chunk between a file and a buffer. */
+typedef struct {
+    /** Descriptor of the file. */
+    int fd;
+    /** The buffer. */
+    char *buffer;
+    /** Number of bytes to transfer. */
+    long long bytes;
+    /** Position of the chunk in the file. */
+    long long offset;
+    /** `true` to write the buffer into the file, `false` to read it. */
+    bool write;
+} transfer;
+
+
+/**
+ * @brief Carry out a transfer; meant to be run by a thread of its own.
+ * @param arg: The transfer.
+ * @return NULL.
+ */
+static void *run_transfer(void *arg) {
+    transfer *tr = (transfer *)arg;
+    long long done = 0;
+
+    while (done < tr->bytes) {
+        ssize_t n = tr->write
+            ? pwrite(tr->fd, tr->buffer + done, tr->bytes - done,
+                     tr->offset + done)
+            : pread(tr->fd, tr->buffer + done, tr->bytes - done,
+                    tr->offset + done);
+        if (n <= 0) {
+            fprintf(stderr, "Could not %s %lld bytes at offset %lld.\n",
+                    tr->write ? "write" : "read", tr->bytes, tr->offset);
+            exit(EXIT_FAILURE);
+        }
+        done += n;
+    }
+    return NULL;
+}
+
+
+/**
+ * @brief Start a transfer in a new thread.
+ * @param thread: The thread (output); to be joined once the transfer is
+ *                needed to be complete.
+ * @param tr:     The transfer; it must stay valid until then.
+ */
+static void start_transfer(pthread_t *thread, transfer *tr) {
+    if (pthread_create(thread, NULL, run_transfer, tr) != 0) {
+        fprintf(stderr, "Could not start the I/O thread.\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+long long stream_sort_file(const char *input, const char *output,
+                           long long chunk_bytes, int nthreads)
+{
+    FILE *in = file_open(input, "rb");
+    FILE *out = file_open(output, "w+b");
+    struct stat st;
+
+    if (fstat(fileno(in), &st) != 0 || st.st_size % sizeof(int) != 0) {
+        fprintf(stderr, "File '%s' is not an array of int.\n", input);
+        exit(EXIT_FAILURE);
+    }
+    posix_fadvise(fileno(in), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    const long long size = st.st_size / sizeof(int);
+    long long chunk = chunk_bytes / sizeof(int);
+    chunk = chunk < 1 ? 1 : (chunk > UINT32_MAX ? UINT32_MAX : chunk);
+    const long long nchunks = (size + chunk - 1) / chunk;
+    int *buffers[2] = {(int *)safe_alloc(sizeof(int) * chunk),
+                       (int *)safe_alloc(sizeof(int) * chunk)};
+    sort_histogram *hist = sort_histogram_create(nthreads);
+    transfer tr[2];
+    pthread_t io[2];
+
+    /* Count every chunk while the next one is being read. */
+    for (long long c = 0; c <= nchunks; c++) {
+        if (c < nchunks) {
+            long long n = c + 1 < nchunks ? chunk : size - c * chunk;
+            tr[c % 2] = (transfer){fileno(in), (char *)buffers[c % 2],
+                                   sizeof(int) * n,
+                                   sizeof(int) * c * chunk, false};
+            start_transfer(&io[c % 2], &tr[c % 2]);
+        }
+        if (c > 0) {
+            pthread_join(io[(c - 1) % 2], NULL);
+            sort_histogram_add(hist, buffers[(c - 1) % 2],
+                               tr[(c - 1) % 2].bytes / sizeof(int));
+        }
+    }
+
+    /* Generate every chunk of the output while the previous one is written. */
+    for (long long c = 0; c < nchunks; c++) {
+        long long n = c + 1 < nchunks ? chunk : size - c * chunk;
+        /* The thread that used this buffer was joined before the last one. */
+        sort_histogram_materialize_range(hist, buffers[c % 2], c * chunk,
+                                         c * chunk + n);
+        if (c > 0)
+            pthread_join(io[(c - 1) % 2], NULL);
+        tr[c % 2] = (transfer){fileno(out), (char *)buffers[c % 2],
+                               sizeof(int) * n, sizeof(int) * c * chunk, true};
+        start_transfer(&io[c % 2], &tr[c % 2]);
+    }
+    if (nchunks > 0)
+        pthread_join(io[(nchunks - 1) % 2], NULL);
+
+    fclose(in);
+    fclose(out);
+    sort_histogram_destroy(hist);
+    free(buffers[0]);
+    free(buffers[1]);
+    return size;
+}
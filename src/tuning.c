@@ -0,0 +1,341 @@
+/**
+ * @file tuning.c
+ * @brief This file contains the functions needed to choose where the threads
+ *        run, how the loops are scheduled and how many threads to use.
+ * @author Marco Plaitano
+ * @date 13 Oct 2021
+ *
+ * COUNTING SORT OpenMP
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * OpenMP.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/* Needed for sched_setaffinity() and the CPU_* macros. */
+#define _GNU_SOURCE
+
+#include "tuning.h"
+
+#ifdef _OPENMP
+    #include <omp.h>
+#else
+    #define omp_get_thread_num() 0
+    #define omp_get_num_threads() 1
+#endif
+
+#ifdef __linux__
+    #include <sched.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "counting_sort.h"
+#include "util.h"
+
+
+/** @brief Number of timed sorts of every candidate of the autotuner. */
+#define AUTOTUNE_ROUNDS 3
+
+
+/** @brief Schedule of a loop. */
+typedef struct {
+    schedule_kind kind;
+    long long chunk;
+} loop_schedule;
+
+
+/** @brief Best number of threads found for a class of arrays. */
+typedef struct {
+    /** Position of the most significant bit of the size. */
+    int size_class;
+    /** Position of the most significant bit of the range. */
+    int range_class;
+    /** Maximum number of threads the autotuner was allowed to use. */
+    int max_threads;
+    /** Fastest number of threads. */
+    int threads;
+} profile_entry;
+
+
+/** @brief Schedule of every loop. */
+static loop_schedule schedules[NUM_LOOPS];
+
+/** @brief Entries found by the autotuner, or loaded from a profile file. */
+static profile_entry *entries = NULL;
+static int nentries = 0;
+
+
+void tuning_set_affinity(thread_affinity policy, int nthreads) {
+#if defined(_OPENMP) && defined(__linux__)
+    /* The CPUs allowed when first called: the ones to pin the threads on. */
+    static cpu_set_t allowed;
+    static int ncpus = -1;
+    static int cpus[CPU_SETSIZE];
+
+    #pragma omp critical (tuning_affinity)
+    {
+        if (ncpus < 0) {
+            ncpus = 0;
+            sched_getaffinity(0, sizeof(allowed), &allowed);
+            for (int c = 0; c < CPU_SETSIZE; c++)
+                if (CPU_ISSET(c, &allowed))
+                    cpus[ncpus++] = c;
+        }
+    }
+
+    #pragma omp parallel num_threads(nthreads)
+    {
+        long long nt = omp_get_num_threads();
+        long long t = omp_get_thread_num();
+        cpu_set_t set = allowed;
+
+        if (policy != AFFINITY_NONE && ncpus > 0) {
+            long long c = policy == AFFINITY_COMPACT ? t % ncpus
+                        : BLOCK_BEGIN(ncpus, t, nt) % ncpus;
+            CPU_ZERO(&set);
+            CPU_SET(cpus[c], &set);
+        }
+        /* pid 0: the calling thread. */
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+#else
+    (void)policy;
+    (void)nthreads;
+#endif
+}
+
+
+void tuning_set_schedule(sort_loop loop, schedule_kind kind, long long chunk) {
+    schedules[loop].kind = kind;
+    schedules[loop].chunk = chunk > 0 ? chunk : 0;
+}
+
+
+bool tuning_custom_schedule(sort_loop loop) {
+    return schedules[loop].kind != SCHEDULE_STATIC || schedules[loop].chunk > 0;
+}
+
+
+saved_schedule tuning_apply_schedule(sort_loop loop) {
+    saved_schedule saved = {0, 0};
+#ifdef _OPENMP
+    const omp_sched_t kinds[] = {omp_sched_static, omp_sched_dynamic,
+                                 omp_sched_guided};
+    omp_sched_t kind;
+    omp_get_schedule(&kind, &saved.chunk);
+    saved.kind = kind;
+    omp_set_schedule(kinds[schedules[loop].kind], schedules[loop].chunk);
+#else
+    (void)loop;
+#endif
+    return saved;
+}
+
+
+void tuning_restore_schedule(saved_schedule saved) {
+#ifdef _OPENMP
+    omp_set_schedule((omp_sched_t)saved.kind, saved.chunk);
+#else
+    (void)saved;
+#endif
+}
+
+
+/**
+ * @brief Return the position of the most significant bit of `n`, the class
+ *        of sizes and ranges sharing the same entries.
+ */
+static int size_class(long long n) {
+    int c = 0;
+    while (n > 1) {
+        n >>= 1;
+        c++;
+    }
+    return c;
+}
+
+
+/**
+ * @brief Add an entry, or replace the one of the same class.
+ * @param entry: The entry.
+ */
+static void add_entry(profile_entry entry) {
+    for (int e = 0; e < nentries; e++) {
+        if (entries[e].size_class == entry.size_class &&
+            entries[e].range_class == entry.range_class &&
+            entries[e].max_threads == entry.max_threads) {
+            entries[e] = entry;
+            return;
+        }
+    }
+
+    profile_entry *grown = (profile_entry *)realloc(
+        entries, sizeof(profile_entry) * (nentries + 1));
+    if (grown == NULL) {
+        fprintf(stderr, "Could not allocate memory for the tuning profile.\n");
+        exit(EXIT_FAILURE);
+    }
+    entries = grown;
+    entries[nentries++] = entry;
+}
+
+
+void tuning_load_profile(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return;
+
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        profile_entry entry;
+        if (line[0] == '#')
+            continue;
+        if (sscanf(line, "%d %d %d %d", &entry.size_class, &entry.range_class,
+                   &entry.max_threads, &entry.threads) != 4 ||
+            entry.threads < 1) {
+            fprintf(stderr, "Invalid line in profile '%s': %s", path, line);
+            exit(EXIT_FAILURE);
+        }
+        add_entry(entry);
+    }
+    fclose(file);
+}
+
+
+void tuning_save_profile(const char *path) {
+    FILE *file = file_open(path, "w");
+
+    fprintf(file, "# size_class range_class max_threads threads\n");
+    for (int e = 0; e < nentries; e++)
+        fprintf(file, "%d %d %d %d\n", entries[e].size_class,
+                entries[e].range_class, entries[e].max_threads,
+                entries[e].threads);
+    fclose(file);
+}
+
+
+/**
+ * @brief Return the seconds taken by the fastest of AUTOTUNE_ROUNDS sorts of
+ *        a random array.
+ * @param array:    Buffer for the array.
+ * @param size:     Number of elements of the array.
+ * @param min:      Minimum value of the array.
+ * @param max:      Maximum value of the array.
+ * @param nthreads: Number of threads to sort with.
+ */
+static double best_sort_time(int *array, long long size, int min, int max,
+                        int nthreads)
+{
+    counting_sort_ctx *ctx = counting_sort_ctx_create(nthreads);
+    double best = 0;
+
+    /*
+     * The first round only grows the buffers of the context and, the first
+     * time this number of threads is used, measures the cost of starting
+     * them; the thresholds of the other numbers, and any set by hand, are
+     * left as they are.
+     */
+    for (int r = -1; r < AUTOTUNE_ROUNDS; r++) {
+        double seconds = 0;
+        array_init_random(array, size, min, max, r + 1, nthreads);
+        START_TIME(seconds);
+        counting_sort_with_ctx(ctx, array, size);
+        END_TIME(seconds);
+        if (r == 0 || (r > 0 && seconds < best))
+            best = seconds;
+    }
+
+    counting_sort_ctx_destroy(ctx);
+    return best;
+}
+
+
+/**
+ * @brief Return the number of threads the autotuner tries after `t`: the
+ *        next power of 2, then `max_threads`; 0 after `max_threads`.
+ */
+static int next_candidate(int t, int max_threads) {
+    if (t >= max_threads)
+        return 0;
+    return t * 2 < max_threads ? t * 2 : max_threads;
+}
+
+
+int tuning_best_threads(long long size, int min, int max, int max_threads) {
+    profile_entry entry = {size_class(size),
+                           size_class((long long)max - min + 1),
+                           max_threads > 1 ? max_threads : 1, 1};
+
+    for (int e = 0; e < nentries; e++)
+        if (entries[e].size_class == entry.size_class &&
+            entries[e].range_class == entry.range_class &&
+            entries[e].max_threads == entry.max_threads)
+            return entries[e].threads;
+
+    if (size > 1 && entry.max_threads > 1) {
+        int *array = (int *)safe_alloc(sizeof(int) * size);
+        double best = best_sort_time(array, size, min, max, 1);
+        for (int t = next_candidate(1, entry.max_threads); t > 0;
+             t = next_candidate(t, entry.max_threads)) {
+            double seconds = best_sort_time(array, size, min, max, t);
+            if (seconds < best) {
+                best = seconds;
+                entry.threads = t;
+            }
+        }
+        free(array);
+    }
+
+    add_entry(entry);
+    return entry.threads;
+}
+
+
+thread_affinity affinity_parse(const char *name) {
+    const char *names[] = {"none", "compact", "spread"};
+
+    for (int a = AFFINITY_NONE; a <= AFFINITY_SPREAD; a++)
+        if (strcmp(name, names[a]) == 0)
+            return (thread_affinity)a;
+
+    fprintf(stderr, "Unknown affinity policy '%s'.\n", name);
+    exit(EXIT_FAILURE);
+}
+
+
+void schedule_parse(const char *spec) {
+    const char *loops[NUM_LOOPS] = {"zero_fill", "histogram", "merge",
+                                    "scatter"};
+    const char *kinds[] = {"static", "dynamic", "guided"};
+    char loop[32], kind[32];
+    long long chunk = 0;
+
+    int n = sscanf(spec, "%31[a-z_]=%31[a-z],%lld", loop, kind, &chunk);
+    for (int l = 0; n >= 2 && l < NUM_LOOPS; l++) {
+        for (int k = SCHEDULE_STATIC; k <= SCHEDULE_GUIDED; k++) {
+            if (strcmp(loop, loops[l]) == 0 && strcmp(kind, kinds[k]) == 0) {
+                tuning_set_schedule((sort_loop)l, (schedule_kind)k, chunk);
+                return;
+            }
+        }
+    }
+
+    fprintf(stderr, "Invalid schedule '%s'.\n", spec);
+    exit(EXIT_FAILURE);
+}
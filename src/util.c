@@ -26,15 +26,46 @@
 
 #include "util.h"
 
+#include <limits.h>
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 
 #ifdef _OPENMP
     #include <omp.h>
 #else
     #define omp_get_thread_num() 0
+    #define omp_get_num_threads() 1
 #endif
 
+#ifdef HAVE_LIBNUMA
+    #include <numa.h>
+#endif
+
+/** @brief Increment of the state of the SplitMix64 generator. */
+#define SPLITMIX_GAMMA 0x9E3779B97F4A7C15ULL
+
+
+double monotonic_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+int team_size(int nthreads) {
+#ifdef _OPENMP
+    return nthreads > 0 ? nthreads : omp_get_max_threads();
+#else
+    (void)nthreads;
+    return 1;
+#endif
+}
+
 
 void *safe_alloc(long long size) {
     if (size < 1) {
@@ -51,6 +82,118 @@ void *safe_alloc(long long size) {
 }
 
 
+void *safe_aligned_alloc(long long alignment, long long size) {
+    if (size < 1) {
+        fprintf(stderr, "Can not allocate memory of %lld bytes.\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+    /* aligned_alloc() requires the size to be a multiple of the alignment. */
+    size = (size + alignment - 1) / alignment * alignment;
+    void *ptr = aligned_alloc(alignment, size);
+    if (ptr == NULL) {
+        fprintf(stderr, "Could not allocate memory of %lld bytes.\n", size);
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
+
+
+void *safe_alloc_huge(long long size) {
+    if (size < 1) {
+        fprintf(stderr, "Can not allocate memory of %lld bytes.\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+    void *ptr = safe_aligned_alloc(HUGE_PAGE_SIZE, size);
+#ifdef MADV_HUGEPAGE
+    /* Only a hint: without THP support the area keeps its regular pages. */
+    madvise(ptr, (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE,
+            MADV_HUGEPAGE);
+#endif
+    return ptr;
+}
+
+
+/**
+ * @brief Touch the pages of a freshly mapped area in parallel, every thread
+ *        the ones starting inside its own block.
+ * @param ptr:      The memory area.
+ * @param size:     Number of bytes of the area.
+ * @param nthreads: Number of threads to use when OpenMP parallelization is
+ *                  enabled.
+ *
+ * The first write to a page decides the node it is placed on, so the blocks
+ * must be the same the array will later be processed with.
+ */
+static void first_touch(char *ptr, long long size, int nthreads) {
+    long long page = sysconf(_SC_PAGESIZE);
+
+    #pragma omp parallel num_threads(nthreads) shared(ptr, size, page)
+    {
+        long long nt = omp_get_num_threads();
+        long long t = omp_get_thread_num();
+        long long begin = BLOCK_BEGIN(size, t, nt);
+        long long end = BLOCK_BEGIN(size, t + 1, nt);
+
+        for (long long p = (begin + page - 1) / page * page; p < end; p += page)
+            ptr[p] = 0;
+    }
+}
+
+
+void *safe_alloc_policy(long long size, alloc_policy policy, int nthreads) {
+    if (policy == ALLOC_DEFAULT)
+        return safe_alloc(size);
+    if (size < 1) {
+        fprintf(stderr, "Can not allocate memory of %lld bytes.\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+    /* An anonymous mapping has no pages yet: none of them is placed. */
+    char *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        fprintf(stderr, "Could not allocate memory of %lld bytes.\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+#ifdef MADV_HUGEPAGE
+    if (size >= HUGE_PAGE_SIZE)
+        madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+
+#ifdef HAVE_LIBNUMA
+    if (policy == ALLOC_INTERLEAVE && numa_available() >= 0)
+        numa_interleave_memory(ptr, size, numa_all_nodes_ptr);
+#endif
+
+    first_touch(ptr, size, nthreads);
+    return ptr;
+}
+
+
+void safe_free_policy(void *ptr, long long size, alloc_policy policy) {
+    if (policy == ALLOC_DEFAULT)
+        free(ptr);
+    else
+        munmap(ptr, size);
+}
+
+
+alloc_policy alloc_policy_parse(const char *name) {
+    if (strcmp(name, "default") == 0)
+        return ALLOC_DEFAULT;
+    if (strcmp(name, "first-touch") == 0)
+        return ALLOC_FIRST_TOUCH;
+    if (strcmp(name, "interleave") == 0)
+        return ALLOC_INTERLEAVE;
+
+    fprintf(stderr, "Unknown allocation policy '%s'.\n", name);
+    exit(EXIT_FAILURE);
+}
+
+
 FILE *file_open(const char *path, const char *mode) {
     FILE *f = fopen(path, mode);
     if (f == NULL) {
@@ -61,23 +204,211 @@ FILE *file_open(const char *path, const char *mode) {
 }
 
 
+void *file_map(const char *path, long long *bytes, file_map_mode mode) {
+    const char *modes[] = {"rb", "r+b", "w+b"};
+    FILE *f = file_open(path, modes[mode]);
+    int fd = fileno(f);
+    struct stat st;
+
+    if (mode == FILE_MAP_CREATE) {
+        if (ftruncate(fd, *bytes) != 0) {
+            fprintf(stderr, "Could not resize file '%s'.\n", path);
+            exit(EXIT_FAILURE);
+        }
+    }
+    else if (fstat(fd, &st) == 0)
+        *bytes = st.st_size;
+    else {
+        fprintf(stderr, "Could not read the size of file '%s'.\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    if (*bytes == 0) {
+        fclose(f);
+        return NULL;
+    }
+
+    int prot = mode == FILE_MAP_READ ? PROT_READ : PROT_READ | PROT_WRITE;
+    int flags = MAP_SHARED | (mode == FILE_MAP_CREATE ? 0 : MAP_POPULATE);
+    void *ptr = mmap(NULL, *bytes, prot, flags, fd, 0);
+    /* The mapping keeps its own reference to the file. */
+    fclose(f);
+    if (ptr == MAP_FAILED) {
+        fprintf(stderr, "Could not map file '%s'.\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    madvise(ptr, *bytes, MADV_SEQUENTIAL);
+    return ptr;
+}
+
+
+void file_unmap(void *ptr, long long bytes) {
+    if (ptr != NULL)
+        munmap(ptr, bytes);
+}
+
+
+/**
+ * @brief Return the random word of the SplitMix64 generator at position `i`
+ *        of the sequence started by `seed`.
+ *
+ * SplitMix64 advances its state by a constant, so the state at any position
+ * is computed directly and only the output mix is left: the generator has no
+ * state to carry between elements, which lets every thread start in the
+ * middle of the sequence and the loop be vectorized.
+ */
+static inline uint64_t splitmix64(uint64_t seed, uint64_t i) {
+    uint64_t z = seed + (i + 1) * SPLITMIX_GAMMA;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+
+/**
+ * @brief Map the 64 random bits `x` to an integer in [0; range).
+ *
+ * The bits are scaled by multiplication instead of taken modulo the range, so
+ * the bias left is below range / 2^64.
+ */
+static inline uint64_t random_below(uint64_t x, uint64_t range) {
+    return ((unsigned __int128)x * range) >> 64;
+}
+
+
+/** @brief Map the 64 random bits `x` to a real number in [0; 1). */
+static inline double random_unit(uint64_t x) {
+    return (x >> 11) * 0x1p-53;
+}
+
+
+/**
+ * @brief Compute element `i` of an array of `size` elements following the
+ *        given distribution.
+ * @param range: Number of values in [min; max].
+ */
+static inline int random_element(long long i, long long size, int min,
+                                 uint64_t range, distribution dist,
+                                 uint64_t seed)
+{
+    uint64_t x = splitmix64(seed, i);
+
+    switch (dist) {
+    case DIST_UNIFORM:
+        return min + (int64_t)random_below(x, range);
+    case DIST_ZIPF: {
+        /* Inverse of the CDF ln(k) / ln(range + 1) of the continuous law. */
+        uint64_t k = exp(random_unit(x) * log((double)range + 1));
+        return min + (int64_t)(k > range ? range : k) - 1;
+    }
+    case DIST_NORMAL: {
+        /* Box-Muller transform, with a second word for the angle. */
+        double u = 1 - random_unit(x);
+        double v = random_unit(splitmix64(~seed, i));
+        double z = sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+        double value = (range - 1) / 2.0 + z * range / 8.0;
+        value = value < 0 ? 0 : (value > range - 1 ? range - 1 : value);
+        return min + (int64_t)llround(value);
+    }
+    case DIST_EQUAL:
+        return min;
+    case DIST_SORTED:
+        return min + (int64_t)((unsigned __int128)i * range / size);
+    case DIST_REVERSE:
+        return min + (int64_t)(range - 1 -
+                               (unsigned __int128)i * range / size);
+    case DIST_FEW:
+        return min + (int64_t)(random_below(x, FEW_DISTINCT) * (range - 1) /
+                               (FEW_DISTINCT - 1));
+    }
+    return min;
+}
+
+
 void array_init_random(int *array, long long size, int min, int max,
-                       int nthreads)
+                       uint64_t seed, int nthreads)
+{
+    array_init_distribution(array, size, min, max, DIST_UNIFORM, seed,
+                            nthreads);
+}
+
+
+void array_init_distribution(int *array, long long size, int min, int max,
+                             distribution dist, uint64_t seed, int nthreads)
+{
+    array_init_slice(array, 0, size, size, min, max, dist, seed, nthreads);
+}
+
+
+void array_init_slice(int *array, long long first, long long size,
+                      long long total, int min, int max, distribution dist,
+                      uint64_t seed, int nthreads)
 {
+    uint64_t range = (uint64_t)((int64_t)max - min + 1);
     long long i = 0;
 
-    #pragma omp parallel num_threads(nthreads) shared(array, size) private(i)
+    /* Write the same block the sort will later read from this thread. */
+    #pragma omp parallel num_threads(nthreads) shared(array, size, range) \
+            private(i)
     {
-        /* Each thread has its own seed to use when calling rand_r(). */
-        unsigned seed = time(NULL) ^ omp_get_thread_num();
+        long long nt = omp_get_num_threads();
+        long long t = omp_get_thread_num();
 
-        #pragma omp for
-        for (i = 0; i < size; i++)
-            array[i] = rand_r(&seed) % (max + 1 - min) + min;
+        for (i = BLOCK_BEGIN(size, t, nt); i < BLOCK_BEGIN(size, t + 1, nt);
+             i++)
+            array[i] = random_element(first + i, total, min, range, dist,
+                                      seed);
     }
 }
 
 
+distribution distribution_parse(const char *name) {
+    const char *names[] = {"uniform", "zipf", "normal", "equal", "sorted",
+                           "reverse", "few"};
+
+    for (int d = DIST_UNIFORM; d <= DIST_FEW; d++)
+        if (strcmp(name, names[d]) == 0)
+            return (distribution)d;
+
+    fprintf(stderr, "Unknown distribution '%s'.\n", name);
+    exit(EXIT_FAILURE);
+}
+
+
+long long array_find_unsorted(const int *array, long long size,
+                              int nthreads)
+{
+    long long first = LLONG_MAX, i = 0;
+
+    /* No early exit: the loop stays branch-free and vectorized. */
+    #pragma omp parallel for num_threads(nthreads) shared(array) private(i) \
+            reduction(min: first) schedule(static)
+    for (i = 1; i < size; i++)
+        first = array[i] < array[i - 1] && i < first ? i : first;
+
+    return first == LLONG_MAX ? -1 : first;
+}
+
+
+uint64_t array_checksum(const int *array, long long size, int nthreads) {
+    uint64_t sum = 0;
+    long long i = 0;
+
+    /*
+     * The values are mixed before being added, so that no two multisets
+     * likely to be produced by a bug (e.g. one value off by one, one
+     * occurrence moved to another value) share the same sum.
+     */
+    #pragma omp parallel for num_threads(nthreads) shared(array) private(i) \
+            reduction(+: sum) schedule(static)
+    for (i = 0; i < size; i++)
+        sum += splitmix64(CHECKSUM_SEED, (uint32_t)array[i]);
+
+    return sum;
+}
+
+
 void array_show(const int *array, long long size) {
     printf("----------------------- ARRAY OF %lld ELEMENTS:\n", size);
     for (long long i = 0; i < size; i++) {
@@ -25,16 +25,41 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "counting_sort.h"
+#include "histogram.h"
+#include "offload_sort.h"
+#include "profile.h"
+#include "radix_sort.h"
+#include "sort_histogram.h"
+#include "sparse_sort.h"
+#include "stream_sort.h"
+#include "tuning.h"
 #include "util.h"
 
 /** @brief Number of array sizes the program is tested with. */
 #define NUM_SIZES 5
 
+/** @brief Default number of random cases compared against qsort(). */
+#define FUZZ_ROUNDS 200
+
+/** @brief log2 of the maximum size of the arrays of the random cases. */
+#define FUZZ_MAX_BITS 20
+
+/**
+ * @brief Seed of the next array generated; printed at start-up so that a
+ *        failing run can be repeated.
+ */
+static uint64_t seed = 0;
+
 
 /**
  * @brief Check that all the elements in the array are in the range [min; max].
@@ -54,6 +79,15 @@ bool elements_in_range(const int *array, long long size, int min, int max);
  */
 void test_initialization(int *array, long long size, int num_threads);
 
+/**
+ * @brief Check that no element in the array has lesser value than its
+ *        predecessor; exit the program otherwise.
+ * @param array:       The array.
+ * @param size:        Number of elements in the array.
+ * @param num_threads: Number of threads to check the array with.
+ */
+void check_sorted(int *array, long long size, int num_threads);
+
 /**
  * @brief Test the correctness of the sorting algorithm.
  * @param array: The array to sort.
@@ -62,12 +96,220 @@ void test_initialization(int *array, long long size, int num_threads);
  */
 void test_sort(int *array, long long size, int num_threads);
 
+/**
+ * @brief Test the correctness of the sorting algorithm when the range of the
+ *        values is given.
+ * @param array: The array to sort.
+ * @param size:  Size of the array.
+ * @param num_threads: Number of threads to use.
+ */
+void test_sort_range(int *array, long long size, int num_threads);
+
+/**
+ * @brief Test the correctness of the sorting algorithm when a few values fall
+ *        far outside of the range most of the others are in.
+ * @param array: The array to sort.
+ * @param size:  Size of the array.
+ * @param num_threads: Number of threads to use.
+ */
+void test_sort_outliers(int *array, long long size, int num_threads);
+
+/**
+ * @brief Test that every histogram strategy produces the same counts.
+ * @param array: The array to count.
+ * @param size:  Size of the array.
+ * @param num_threads: Number of threads to use.
+ */
+void test_histogram_modes(int *array, long long size, int num_threads);
+
+/**
+ * @brief Test the 64-bit counters used when a value can occur more than 2^32
+ *        times.
+ * @param array: The array to count.
+ * @param size:  Size of the array.
+ * @param num_threads: Number of threads to use.
+ */
+void test_histogram_wide(int *array, long long size, int num_threads);
+
+/**
+ * @brief Test the correctness of the sorting algorithm on arrays of the other
+ *        integer types.
+ * @param size:  Size of the arrays.
+ * @param num_threads: Number of threads to use.
+ */
+void test_sort_types(long long size, int num_threads);
+
+/**
+ * @brief Test the correctness and stability of the sorting algorithm on an
+ *        array of records.
+ * @param size:  Number of records.
+ * @param num_threads: Number of threads to use.
+ */
+void test_sort_records(long long size, int num_threads);
+
+/**
+ * @brief Test that sorting keys with their values and computing the sorting
+ *        permutation give the same, stable, order.
+ * @param size:  Number of keys.
+ * @param num_threads: Number of threads to use.
+ */
+void test_sort_by_key(long long size, int num_threads);
+
+/**
+ * @brief Test the correctness of the sorting algorithms on values spread over
+ *        the whole range of integers.
+ * @param array: The array to sort.
+ * @param size:  Size of the array.
+ * @param num_threads: Number of threads to use.
+ */
+void test_sort_wide_range(int *array, long long size, int num_threads);
+
+/**
+ * @brief Test the correctness of the sorting algorithms on few distinct values
+ *        spread over the whole range of integers.
+ * @param array: The array to sort.
+ * @param size:  Size of the array.
+ * @param num_threads: Number of threads to use.
+ */
+void test_sort_sparse(int *array, long long size, int num_threads);
+
+/**
+ * @brief Test the correctness of the sorting algorithm when the same context
+ *        is reused for arrays of different sizes and ranges.
+ * @param ctx:   The context.
+ * @param array: The array to sort.
+ * @param size:  Size of the array.
+ * @param num_threads: Number of threads to use.
+ */
+void test_sort_with_ctx(counting_sort_ctx *ctx, int *array, long long size,
+                        int num_threads);
+
+/**
+ * @brief Test the correctness of every path small arrays can take, by forcing
+ *        the thresholds that choose between them.
+ * @param array: The array to sort.
+ * @param size:  Size of the array.
+ * @param num_threads: Number of threads to use.
+ */
+void test_sort_small_paths(int *array, long long size, int num_threads);
+
+/**
+ * @brief Test sorting arrays allocated with every NUMA placement policy.
+ * @param size:        Size of the arrays.
+ * @param num_threads: Number of threads to use.
+ */
+void test_alloc_policies(long long size, int num_threads);
+
+/**
+ * @brief Test generating and sorting arrays of every distribution.
+ * @param array: The array to use.
+ * @param size:  Size of the array.
+ * @param num_threads: Number of threads to use.
+ */
+void test_distributions(int *array, long long size, int num_threads);
+
+/**
+ * @brief Test sorting a mapped file, in place and into a second file.
+ * @param size:        Number of elements of the file.
+ * @param num_threads: Number of threads to use.
+ */
+void test_file_map(long long size, int num_threads);
+
+/**
+ * @brief Test sorting a file as a stream of small chunks.
+ * @param size:        Number of elements of the file.
+ * @param num_threads: Number of threads to use.
+ */
+void test_stream_sort(long long size, int num_threads);
+
+/**
+ * @brief Test the offload backend, one array at a time and in batches that
+ *        reuse the device buffers.
+ * @param size:        Number of elements of the largest array.
+ * @param num_threads: Number of threads to use.
+ */
+void test_offload_sort(long long size, int num_threads);
+
+/**
+ * @brief Test that the phases of the sort are measured for every thread.
+ * @param array:       The array.
+ * @param size:        Number of elements of the array.
+ * @param num_threads: Number of threads to use.
+ */
+void test_profile(int *array, long long size, int num_threads);
+
+/**
+ * @brief Test sorting with every affinity policy and loop schedule, and the
+ *        thread counts of the autotuner and of its profile file.
+ * @param array:       The array.
+ * @param size:        Number of elements of the array.
+ * @param num_threads: Number of threads to use.
+ */
+void test_tuning(int *array, long long size, int num_threads);
+
+/**
+ * @brief Test adding, removing and merging batches of a histogram, and the
+ *        sorted values, or slices of them, it gives.
+ * @param array:       The array.
+ * @param size:        Number of elements of the array.
+ * @param num_threads: Number of threads to use.
+ */
+void test_sort_histogram(int *array, long long size, int num_threads);
+
+/**
+ * @brief Test the strategy chosen for arrays that are dense, sparse, spread
+ *        over a wide range, or dense with a few far outliers.
+ * @param ctx:         The context to sort with.
+ * @param array:       The array.
+ * @param size:        Number of elements of the array.
+ * @param num_threads: Number of threads to use.
+ */
+void test_sort_strategies(counting_sort_ctx *ctx, int *array, long long size,
+                          int num_threads);
+
+/**
+ * @brief Compare every sorting entry point against qsort() on random cases:
+ *        random sizes, ranges, distributions and numbers of threads.
+ * @param max_threads: Maximum number of threads to use.
+ * @param rounds:      Number of cases.
+ *
+ * Every case is generated from the seed of the program, and printed when it
+ * fails, so that it can be repeated.
+ */
+void test_fuzz(int max_threads, int rounds);
+
+/**
+ * @brief Test sorting a batch of arrays of mixed sizes and ranges, some of
+ *        them split among the threads and some not.
+ * @param size:        Size of the largest array of the batch.
+ * @param num_threads: Number of threads to use.
+ */
+void test_sort_batch(long long size, int num_threads);
+
+
+
+/** @brief 16-byte record sorted by a 16-bit field. */
+typedef struct {
+    uint64_t payload;
+    uint32_t check;
+    uint16_t key;
+    uint16_t unused;
+} record;
+
+
+/** @brief Return the key of a record. */
+long long record_key(const void *r) {
+    return ((const record *)r)->key;
+}
+
 
 
 int main(int argc, char **argv) {
     int num_threads = 0;
-    if (argc == 2)
+    if (argc >= 2)
         num_threads = atoi(argv[1]);
+    seed = argc >= 3 ? strtoull(argv[2], NULL, 10) : (uint64_t)time(NULL);
+    int fuzz_rounds = argc >= 4 ? atoi(argv[3]) : FUZZ_ROUNDS;
     if (num_threads < 0) {
         fprintf(stderr, "Can not launch program with a negative number of "
                         "threads (%d).\n", num_threads);
@@ -75,6 +317,8 @@ int main(int argc, char **argv) {
     }
 
     long long sizes[NUM_SIZES] = {10, 6053, 30000, 500009, 20000000};
+    counting_sort_ctx *ctx = counting_sort_ctx_create(num_threads);
+    printf("Testing with seed %llu.\n", (unsigned long long)seed);
 
     for (int i = 0; i < NUM_SIZES; i++) {
         printf("Testing size %lld (%d/%d) with %d threads...\n", sizes[i],
@@ -84,10 +328,34 @@ int main(int argc, char **argv) {
         int *array = (int *)safe_alloc(sizes[i] * sizeof(int));
         test_initialization(array, sizes[i], num_threads);
         test_sort(array, sizes[i], num_threads);
+        test_sort_range(array, sizes[i], num_threads);
+        test_sort_outliers(array, sizes[i], num_threads);
+        test_histogram_modes(array, sizes[i], num_threads);
+        test_histogram_wide(array, sizes[i], num_threads);
+        test_sort_types(sizes[i], num_threads);
+        test_sort_records(sizes[i], num_threads);
+        test_sort_by_key(sizes[i], num_threads);
+        test_sort_wide_range(array, sizes[i], num_threads);
+        test_sort_sparse(array, sizes[i], num_threads);
+        test_sort_with_ctx(ctx, array, sizes[i], num_threads);
+        test_sort_small_paths(array, sizes[i], num_threads);
+        test_alloc_policies(sizes[i], num_threads);
+        test_distributions(array, sizes[i], num_threads);
+        test_file_map(sizes[i], num_threads);
+        test_stream_sort(sizes[i], num_threads);
+        test_offload_sort(sizes[i], num_threads);
+        test_profile(array, sizes[i], num_threads);
+        test_tuning(array, sizes[i], num_threads);
+        test_sort_batch(sizes[i], num_threads);
+        test_sort_strategies(ctx, array, sizes[i], num_threads);
+        test_sort_histogram(array, sizes[i], num_threads);
 
         free(array);
     }
 
+    test_fuzz(num_threads, fuzz_rounds);
+
+    counting_sort_ctx_destroy(ctx);
     return EXIT_SUCCESS;
 }
 
@@ -104,7 +372,7 @@ void test_initialization(int *array, long long size, int num_threads) {
     for (long long i = 0; i < size; i++)
         array[i] = RANGE_MIN - 1;
 
-    array_init_random(array, size, RANGE_MIN, RANGE_MAX, num_threads);
+    array_init_random(array, size, RANGE_MIN, RANGE_MAX, seed, num_threads);
 
     /* Check that all elements are constrained in the range [min; max]. */
     if (!elements_in_range(array, size, RANGE_MIN, RANGE_MAX)) {
@@ -114,21 +382,1029 @@ void test_initialization(int *array, long long size, int num_threads) {
         free(array);
         exit(EXIT_FAILURE);
     }
+
+    /* The same seed must give the same array with a single thread. */
+    int *serial = (int *)safe_alloc(size * sizeof(int));
+    array_init_random(serial, size, RANGE_MIN, RANGE_MAX, seed++, 1);
+    for (long long i = 0; i < size; i++)
+        if (serial[i] != array[i]) {
+            fprintf(stderr, "FAILED Initialization!\n"
+                            "array[%lld] differs from the serial one\n", i);
+            exit(EXIT_FAILURE);
+        }
+    free(serial);
     fprintf(stdout, "OK Initialization.\n");
 }
 
 
+void check_sorted(int *array, long long size, int num_threads) {
+    long long i = array_find_unsorted(array, size, num_threads);
+    if (i >= 0) {
+        fprintf(stderr, "FAILED Sorting!\n"
+                        "array[%lld] %d > %d array[%lld]\n",
+                        i - 1, array[i - 1], array[i], i);
+        free(array);
+        exit(EXIT_FAILURE);
+    }
+}
+
 void test_sort(int *array, long long size, int num_threads) {
+    uint64_t checksum = array_checksum(array, size, num_threads);
+    counting_sort(array, size, num_threads);
+
+    /* Check that no element has lesser value than its predecessor... */
+    check_sorted(array, size, num_threads);
+    /* ... and that the elements are the same ones as before. */
+    if (array_checksum(array, size, num_threads) != checksum) {
+        fprintf(stderr, "FAILED Sorting!\n"
+                        "The sorted array holds different values\n");
+        free(array);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(stdout, "OK Sorting.\n");
+}
+
+void test_sort_range(int *array, long long size, int num_threads) {
+    array_init_random(array, size, RANGE_MIN, RANGE_MAX, seed++, num_threads);
+    counting_sort_range(array, size, RANGE_MIN, RANGE_MAX, num_threads);
+
+    check_sorted(array, size, num_threads);
+    fprintf(stdout, "OK Sorting with known range.\n");
+}
+
+
+void test_sort_outliers(int *array, long long size, int num_threads) {
+    array_init_random(array, size, RANGE_MIN, RANGE_MAX, seed++, num_threads);
+    /* Values the speculative histogram can not predict from a sample. */
+    array[size / 3] = RANGE_MIN - 12345;
+    array[size - 1] = RANGE_MAX * 3;
     counting_sort(array, size, num_threads);
 
-    /* Check that no element has lesser value than its predecessor. */
-    for (long long i = size - 1; i > 0; i--)
-        if (array[i] < array[i - 1]) {
-            fprintf(stderr, "FAILED Sorting!\n"
-                            "array[%lld] %d > %d array[%lld]\n",
-                            i - 1, array[i - 1], array[i], i);
-            free(array);
+    check_sorted(array, size, num_threads);
+    if (array[0] != RANGE_MIN - 12345 || array[size - 1] != RANGE_MAX * 3) {
+        fprintf(stderr, "FAILED Sorting with outliers!\n"
+                        "Extremes are %d and %d\n", array[0], array[size - 1]);
+        free(array);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(stdout, "OK Sorting with outliers.\n");
+}
+
+
+void test_histogram_modes(int *array, long long size, int num_threads) {
+    array_init_random(array, size, RANGE_MIN, RANGE_MAX, seed++, num_threads);
+    /*
+     * Leave RANGE_MAX out of the range to also check the skipped values. The
+     * second round piles the values up in a few buckets of a range twice as
+     * wide, so that the narrow counters (8 bits, this time) wrap around.
+     */
+    long long count_size = RANGE_MAX - RANGE_MIN;
+    uint32_t *priv = (uint32_t *)safe_alloc(sizeof(uint32_t) * count_size * 2);
+    uint32_t *other = (uint32_t *)safe_alloc(sizeof(uint32_t) * count_size * 2);
+    const char *names[] = {"auto", "private", "atomic", "narrow"};
+
+    for (int round = 0; round < 2; round++) {
+        if (round == 1) {
+            count_size *= 2;
+            for (long long i = 0; i < size; i++)
+                array[i] = RANGE_MIN + (array[i] % 16) * 1000;
+        }
+        long long priv_skipped = histogram_build(array, size, RANGE_MIN, priv,
+                                                 count_size, COUNT_32, NULL,
+                                                 NULL, HISTOGRAM_PRIVATE,
+                                                 num_threads);
+
+        long long total = priv_skipped;
+        for (long long i = 0; i < count_size; i++)
+            total += priv[i];
+        if (total != size) {
+            fprintf(stderr, "FAILED Histogram!\n"
+                            "Counted %lld elements out of %lld\n", total,
+                            size);
             exit(EXIT_FAILURE);
         }
-    fprintf(stdout, "OK Sorting.\n");
+
+        for (int mode = HISTOGRAM_ATOMIC; mode <= HISTOGRAM_NARROW; mode++) {
+            long long skipped = histogram_build(array, size, RANGE_MIN, other,
+                                                count_size, COUNT_32, NULL,
+                                                NULL, (histogram_mode)mode,
+                                                num_threads);
+            for (long long i = 0; i < count_size; i++)
+                if (priv[i] != other[i]) {
+                    fprintf(stderr, "FAILED Histogram!\n"
+                                    "count[%lld] is %u (private) and %u "
+                                    "(%s)\n", i, priv[i], other[i],
+                                    names[mode]);
+                    exit(EXIT_FAILURE);
+                }
+            if (skipped != priv_skipped) {
+                fprintf(stderr, "FAILED Histogram!\n"
+                                "Skipped %lld (private) and %lld (%s) "
+                                "elements\n", priv_skipped, skipped,
+                                names[mode]);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    free(priv);
+    free(other);
+    fprintf(stdout, "OK Histogram.\n");
+}
+
+
+void test_histogram_wide(int *array, long long size, int num_threads) {
+    /* Counters must be widened exactly when 32 bits may not be enough. */
+    if (histogram_width(UINT32_MAX) != COUNT_32 ||
+        histogram_width((long long)UINT32_MAX + 1) != COUNT_64) {
+        fprintf(stderr, "FAILED Wide histogram!\n"
+                        "Wrong counter width chosen around 2^32\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /*
+     * An array of 2^32 identical elements does not fit in memory here: run the
+     * wide kernels on a smaller one, with every element in the same bucket.
+     */
+    for (long long i = 0; i < size; i++)
+        array[i] = RANGE_MAX;
+    uint64_t *wide = (uint64_t *)safe_alloc(sizeof(uint64_t));
+    for (int mode = HISTOGRAM_PRIVATE; mode <= HISTOGRAM_NARROW; mode++) {
+        histogram_build(array, size, RANGE_MAX, wide, 1, COUNT_64, NULL, NULL,
+                        mode, num_threads);
+        if (wide[0] != (uint64_t)size) {
+            fprintf(stderr, "FAILED Wide histogram!\n"
+                            "Counted %llu elements instead of %lld\n",
+                            (unsigned long long)wide[0], size);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    free(wide);
+
+    /*
+     * Synthetic counts past 2^32, through the prefix sum and the write-back of
+     * the windows around the positions that overflow 32 bits.
+     */
+    const uint64_t counts[3] = {(uint64_t)UINT32_MAX + 3, 5, UINT32_MAX};
+    const uint32_t counts32[3] = {UINT32_MAX, UINT32_MAX, 2};
+    long long offset[4], offset32[4];
+    int window[16];
+    counting_sort_offsets(counts, 3, COUNT_64, offset);
+    counting_sort_offsets(counts32, 3, COUNT_32, offset32);
+    if (offset[1] != (long long)UINT32_MAX + 3 ||
+        offset[3] != 2LL * UINT32_MAX + 8 ||
+        offset32[2] != 2LL * UINT32_MAX ||
+        offset32[3] != 2LL * UINT32_MAX + 2) {
+        fprintf(stderr, "FAILED Wide histogram!\n"
+                        "Prefix sum wrapped around 2^32\n");
+        exit(EXIT_FAILURE);
+    }
+    const long long firsts[3] = {UINT32_MAX - 8, offset[2] - 8, offset[3] - 16};
+    for (int w = 0; w < 3; w++) {
+        counting_sort_fill(window, firsts[w], 16, offset, 3, -1, num_threads);
+        for (long long i = 0; i < 16; i++) {
+            long long pos = firsts[w] + i;
+            int expected = pos < offset[1] ? -1 : (pos < offset[2] ? 0 : 1);
+            if (window[i] != expected) {
+                fprintf(stderr, "FAILED Wide histogram!\n"
+                                "Position %lld holds %d instead of %d\n",
+                        pos, window[i], expected);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    fprintf(stdout, "OK Wide histogram.\n");
+}
+
+
+void test_sort_types(long long size, int num_threads) {
+    uint8_t *a8 = (uint8_t *)safe_alloc(size * sizeof(uint8_t));
+    uint16_t *a16 = (uint16_t *)safe_alloc(size * sizeof(uint16_t));
+    int64_t *a64 = (int64_t *)safe_alloc(size * sizeof(int64_t));
+    int *values = (int *)safe_alloc(size * sizeof(int));
+    long long sum8 = 0, sum16 = 0;
+
+    array_init_random(values, size, RANGE_MIN, RANGE_MAX, seed++, num_threads);
+    for (long long i = 0; i < size; i++) {
+        a8[i] = values[i];
+        a16[i] = values[i];
+        /* Spread the values beyond the range of 32-bit integers. */
+        a64[i] = (int64_t)values[i] - 3000000000LL;
+        sum8 += a8[i];
+        sum16 += a16[i];
+    }
+
+    counting_sort_u8(a8, size, num_threads);
+    counting_sort_u16(a16, size, num_threads);
+    counting_sort_i64(a64, size, num_threads);
+
+    for (long long i = 1; i < size; i++)
+        if (a8[i] < a8[i - 1] || a16[i] < a16[i - 1] || a64[i] < a64[i - 1]) {
+            fprintf(stderr, "FAILED Sorting other types!\n"
+                            "Elements %lld and %lld are not sorted\n",
+                            i - 1, i);
+            exit(EXIT_FAILURE);
+        }
+
+    /* The whole range of the small types is counted by kernels of its own. */
+    for (long long i = 0; i < size; i++) {
+        sum8 -= a8[i];
+        sum16 -= a16[i];
+    }
+    if (sum8 != 0 || sum16 != 0) {
+        fprintf(stderr, "FAILED Sorting other types!\n"
+                        "The sorted arrays hold different values\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* Same for the 64-bit counters, against the shared histogram. */
+    uint64_t full[UINT8_MAX + 1], shared[UINT8_MAX + 1];
+    histogram_build_typed(a8, ELEM_U8, size, 0, full, UINT8_MAX + 1, COUNT_64,
+                          NULL, NULL, HISTOGRAM_PRIVATE, num_threads);
+    histogram_build_typed(a8, ELEM_U8, size, 0, shared, UINT8_MAX + 1,
+                          COUNT_64, NULL, NULL, HISTOGRAM_ATOMIC, num_threads);
+    if (memcmp(full, shared, sizeof(full)) != 0) {
+        fprintf(stderr, "FAILED Sorting other types!\n"
+                        "Wrong histogram of the whole range of uint8_t\n");
+        exit(EXIT_FAILURE);
+    }
+
+    free(a8);
+    free(a16);
+    free(a64);
+    free(values);
+    fprintf(stdout, "OK Sorting other types.\n");
+}
+
+
+void test_sort_records(long long size, int num_threads) {
+    record *in = (record *)safe_alloc(size * sizeof(record));
+    record *out = (record *)safe_alloc(size * sizeof(record));
+    int *values = (int *)safe_alloc(size * sizeof(int));
+
+    /* Few distinct keys, so that stability is actually put to the test. */
+    array_init_random(values, size, 0, 999, seed++, num_threads);
+    for (long long i = 0; i < size; i++) {
+        in[i].payload = i;
+        in[i].key = values[i];
+        in[i].check = values[i] ^ (uint32_t)i;
+        in[i].unused = 0;
+    }
+
+    long long *perm = (long long *)safe_alloc(size * sizeof(long long));
+    counting_sort_records(in, out, size, sizeof(record), record_key,
+                          num_threads);
+    counting_sort_records_perm(in, perm, size, sizeof(record), record_key,
+                               num_threads);
+
+    for (long long i = 0; i < size; i++) {
+        bool intact = out[i].check == (out[i].key ^ (uint32_t)out[i].payload) &&
+                      out[i].payload == (uint64_t)perm[i];
+        bool ordered = i == 0 || out[i - 1].key < out[i].key ||
+                       (out[i - 1].key == out[i].key &&
+                        out[i - 1].payload < out[i].payload);
+        if (!intact || !ordered) {
+            fprintf(stderr, "FAILED Sorting records!\n"
+                            "Record %lld is %s\n", i,
+                            intact ? "out of order" : "corrupted");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    free(in);
+    free(out);
+    free(perm);
+    free(values);
+    fprintf(stdout, "OK Sorting records.\n");
+}
+
+
+void test_sort_by_key(long long size, int num_threads) {
+    int *keys = (int *)safe_alloc(size * sizeof(int));
+    int *keys_out = (int *)safe_alloc(size * sizeof(int));
+    long long *values = (long long *)safe_alloc(size * sizeof(long long));
+    long long *values_out = (long long *)safe_alloc(size * sizeof(long long));
+    long long *perm = (long long *)safe_alloc(size * sizeof(long long));
+
+    for (long long i = 0; i < size; i++)
+        values[i] = i;
+
+    /* A narrow range is counted; the whole range of int goes to Radix Sort. */
+    const int mins[2] = {-500, INT_MIN}, maxs[2] = {500, INT_MAX};
+    for (int r = 0; r < 2; r++) {
+        array_init_random(keys, size, mins[r], maxs[r], seed++, num_threads);
+        /* Repeat keys, so that the order of equal ones is checked as well. */
+        for (long long i = 2; i < size; i += 3)
+            keys[i] = keys[i - 2];
+
+        counting_sort_by_key(keys, values, size, sizeof(long long), keys_out,
+                             values_out, num_threads);
+        counting_sort_perm(keys, perm, size, num_threads);
+
+        for (long long i = 0; i < size; i++) {
+            bool ordered = i == 0 || keys_out[i - 1] < keys_out[i] ||
+                           (keys_out[i - 1] == keys_out[i] &&
+                            values_out[i - 1] < values_out[i]);
+            if (!ordered || values_out[i] != perm[i] ||
+                keys[perm[i]] != keys_out[i]) {
+                fprintf(stderr, "FAILED Sorting by key!\n"
+                                "Position %lld holds key %d and value %lld\n",
+                                i, keys_out[i], values_out[i]);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    /* An empty input has no first key to measure the range from. */
+    counting_sort_by_key(keys, values, 0, sizeof(long long), keys_out,
+                         values_out, num_threads);
+    counting_sort_perm(keys, perm, 0, num_threads);
+
+    free(keys);
+    free(keys_out);
+    free(values);
+    free(values_out);
+    free(perm);
+    fprintf(stdout, "OK Sorting by key.\n");
+}
+
+
+void test_sort_wide_range(int *array, long long size, int num_threads) {
+    unsigned seed = size;
+
+    /* counting_sort() can not allocate a histogram for such a range. */
+    for (int round = 0; round < 2; round++) {
+        long long sum = 0;
+        for (long long i = 0; i < size; i++) {
+            if (i < 2)
+                array[i] = i == 0 ? INT_MAX : INT_MIN;
+            else
+                array[i] = (int)((unsigned)rand_r(&seed) << 16 ^
+                                 rand_r(&seed));
+            sum += array[i];
+        }
+
+        if (round == 0)
+            counting_sort(array, size, num_threads);
+        else
+            radix_sort(array, size, num_threads);
+
+        check_sorted(array, size, num_threads);
+        for (long long i = 0; i < size; i++)
+            sum -= array[i];
+        if (sum != 0 || array[0] != INT_MIN || array[size - 1] != INT_MAX) {
+            fprintf(stderr, "FAILED Sorting wide range!\n"
+                            "Elements have been lost or duplicated\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    fprintf(stdout, "OK Sorting wide range.\n");
+}
+
+
+void test_sort_sparse(int *array, long long size, int num_threads) {
+    /* 1000 distinct values, the i-th of which is i * 4000037 - 2000018500. */
+    array_init_random(array, size, 0, 999, seed++, num_threads);
+    for (long long i = 0; i < size; i++)
+        array[i] = array[i] * 4000037 - 2000018500;
+
+    long long distinct = estimate_distinct(array, size);
+    if (size >= 500000 && (distinct < 500 || distinct > 2000)) {
+        fprintf(stderr, "FAILED Sparse sorting!\n"
+                        "Estimated %lld distinct values instead of 1000\n",
+                        distinct);
+        exit(EXIT_FAILURE);
+    }
+
+    for (int round = 0; round < 2; round++) {
+        if (round == 0)
+            sparse_sort(array, size, num_threads);
+        else {
+            array_init_random(array, size, 0, 999, seed++, num_threads);
+            for (long long i = 0; i < size; i++)
+                array[i] = array[i] * 4000037 - 2000018500;
+            counting_sort(array, size, num_threads);
+        }
+
+        check_sorted(array, size, num_threads);
+        for (long long i = 0; i < size; i++)
+            if ((array[i] + 2000018500LL) % 4000037 != 0) {
+                fprintf(stderr, "FAILED Sparse sorting!\n"
+                                "Unexpected value %d\n", array[i]);
+                exit(EXIT_FAILURE);
+            }
+    }
+    fprintf(stdout, "OK Sparse sorting.\n");
+}
+
+
+void test_sort_with_ctx(counting_sort_ctx *ctx, int *array, long long size,
+                        int num_threads)
+{
+    /* Narrow, default and wide ranges, growing the buffers in between. */
+    int ranges[3] = {100, RANGE_MAX, RANGE_MAX * 1000};
+
+    for (int r = 0; r < 3; r++) {
+        array_init_random(array, size, -ranges[r], ranges[r], seed++, num_threads);
+        counting_sort_with_ctx(ctx, array, size);
+        check_sorted(array, size, num_threads);
+    }
+    fprintf(stdout, "OK Sorting with context.\n");
+}
+
+
+void test_sort_small_paths(int *array, long long size, int num_threads) {
+    /* Larger arrays never take these paths. */
+    if (size > 30000)
+        return;
+
+    /* Insertion Sort, serial Counting Sort and the single parallel region. */
+    double insertion_costs[3] = {0, 1, 1};
+    long long serial_thresholds[3] = {size, size, 0};
+
+    for (int p = 0; p < 3; p++) {
+        counting_sort_set_thresholds(insertion_costs[p], 1, 1,
+                                     serial_thresholds[p], num_threads);
+        array_init_random(array, size, RANGE_MIN, RANGE_MAX, seed++, num_threads);
+        counting_sort(array, size, num_threads);
+        check_sorted(array, size, num_threads);
+    }
+
+    counting_sort_calibrate(num_threads);
+    fprintf(stdout, "OK Sorting small arrays.\n");
+}
+
+
+void test_alloc_policies(long long size, int num_threads) {
+    alloc_policy policies[3] = {ALLOC_DEFAULT, ALLOC_FIRST_TOUCH,
+                                ALLOC_INTERLEAVE};
+
+    for (int p = 0; p < 3; p++) {
+        int *array = (int *)safe_alloc_policy(size * sizeof(int), policies[p],
+                                              num_threads);
+        array_init_random(array, size, RANGE_MIN, RANGE_MAX, seed++, num_threads);
+        counting_sort(array, size, num_threads);
+        check_sorted(array, size, num_threads);
+        safe_free_policy(array, size * sizeof(int), policies[p]);
+    }
+    fprintf(stdout, "OK Allocation policies.\n");
+}
+
+
+void test_distributions(int *array, long long size, int num_threads) {
+    const int min = -1000, max = 250000;
+
+    for (int d = DIST_UNIFORM; d <= DIST_FEW; d++) {
+        array_init_distribution(array, size, min, max, (distribution)d, seed++,
+                                num_threads);
+        if (!elements_in_range(array, size, min, max)) {
+            fprintf(stderr, "FAILED Distributions!\n"
+                            "Distribution %d is not in the range [%d, %d]\n",
+                            d, min, max);
+            exit(EXIT_FAILURE);
+        }
+
+        for (long long i = 1; i < size; i++)
+            if ((d == DIST_SORTED && array[i] < array[i - 1]) ||
+                (d == DIST_REVERSE && array[i] > array[i - 1])) {
+                fprintf(stderr, "FAILED Distributions!\n"
+                                "Distribution %d is not in order at %lld\n",
+                                d, i);
+                exit(EXIT_FAILURE);
+            }
+
+        long long distinct = 1;
+        counting_sort(array, size, num_threads);
+        check_sorted(array, size, num_threads);
+        for (long long i = 1; i < size; i++)
+            distinct += array[i] != array[i - 1];
+        if ((d == DIST_EQUAL && distinct != 1) ||
+            (d == DIST_FEW && distinct > FEW_DISTINCT)) {
+            fprintf(stderr, "FAILED Distributions!\n"
+                            "Distribution %d has %lld distinct values\n",
+                            d, distinct);
+            exit(EXIT_FAILURE);
+        }
+    }
+    fprintf(stdout, "OK Distributions.\n");
+}
+
+
+void test_file_map(long long size, int num_threads) {
+    char input[] = "/tmp/counting_sort_in_XXXXXX";
+    char output[] = "/tmp/counting_sort_out_XXXXXX";
+    close(mkstemp(input));
+    close(mkstemp(output));
+
+    /* Narrow and wide ranges: the latter can not be counted straight. */
+    int ranges[2] = {RANGE_MAX, RANGE_MAX * 1000};
+    for (int r = 0; r < 2; r++) {
+        long long bytes = size * sizeof(int);
+        int *array = file_map(input, &bytes, FILE_MAP_CREATE);
+        array_init_random(array, size, -ranges[r], ranges[r], seed++,
+                          num_threads);
+        long long sum = 0;
+        for (long long i = 0; i < size; i++)
+            sum += array[i];
+        file_unmap(array, bytes);
+
+        array = file_map(input, &bytes, FILE_MAP_READ);
+        int *sorted = file_map(output, &bytes, FILE_MAP_CREATE);
+        if (bytes != size * (long long)sizeof(int)) {
+            fprintf(stderr, "FAILED File mapping!\n"
+                            "File of %lld bytes instead of %lld\n", bytes,
+                            size * (long long)sizeof(int));
+            exit(EXIT_FAILURE);
+        }
+        counting_sort_copy(array, sorted, size, num_threads);
+        file_unmap(array, bytes);
+        check_sorted(sorted, size, num_threads);
+        for (long long i = 0; i < size; i++)
+            sum -= sorted[i];
+        file_unmap(sorted, bytes);
+        if (sum != 0) {
+            fprintf(stderr, "FAILED File mapping!\n"
+                            "The sorted file has different values\n");
+            exit(EXIT_FAILURE);
+        }
+
+        /* The input file, sorted in place. */
+        array = file_map(input, &bytes, FILE_MAP_UPDATE);
+        counting_sort(array, size, num_threads);
+        file_unmap(array, bytes);
+        array = file_map(input, &bytes, FILE_MAP_READ);
+        check_sorted(array, size, num_threads);
+        file_unmap(array, bytes);
+    }
+
+    unlink(input);
+    unlink(output);
+    fprintf(stdout, "OK File mapping.\n");
+}
+
+
+void test_stream_sort(long long size, int num_threads) {
+    char input[] = "/tmp/counting_sort_in_XXXXXX";
+    char output[] = "/tmp/counting_sort_out_XXXXXX";
+    close(mkstemp(input));
+    close(mkstemp(output));
+
+    /* Sorted input widens the range of the histogram at every chunk. */
+    distribution dists[2] = {DIST_UNIFORM, DIST_REVERSE};
+    for (int d = 0; d < 2; d++) {
+        long long bytes = size * sizeof(int);
+        int *array = file_map(input, &bytes, FILE_MAP_CREATE);
+        array_init_distribution(array, size, -RANGE_MAX, RANGE_MAX, dists[d],
+                                seed++, num_threads);
+        long long sum = 0;
+        for (long long i = 0; i < size; i++)
+            sum += array[i];
+        file_unmap(array, bytes);
+
+        /* Chunks of a few thousand elements, not a divisor of the size. */
+        long long sorted_size = stream_sort_file(input, output, 30004,
+                                                 num_threads);
+        int *sorted = file_map(output, &bytes, FILE_MAP_READ);
+        if (sorted_size != size || bytes != size * (long long)sizeof(int)) {
+            fprintf(stderr, "FAILED Stream sorting!\n"
+                            "%lld elements written instead of %lld\n",
+                            bytes / (long long)sizeof(int), size);
+            exit(EXIT_FAILURE);
+        }
+        check_sorted(sorted, size, num_threads);
+        for (long long i = 0; i < size; i++)
+            sum -= sorted[i];
+        file_unmap(sorted, bytes);
+
+        if (sum != 0) {
+            fprintf(stderr, "FAILED Stream sorting!\n"
+                            "The sorted file has different values\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    unlink(input);
+    unlink(output);
+    fprintf(stdout, "OK Stream sorting.\n");
+}
+
+
+void test_offload_sort(long long size, int num_threads) {
+    /*
+     * Ranges below and above the shared memory histogram, and one too wide
+     * for the device; the arrays get smaller to make the batch uneven.
+     */
+    int ranges[3] = {200, 100000, RANGE_MAX};
+    int *arrays[3], *expected[3];
+    long long sizes[3];
+    offload_ctx *ctx = offload_ctx_create(num_threads);
+
+    for (int a = 0; a < 3; a++) {
+        sizes[a] = size / (a + 1);
+        arrays[a] = (int *)safe_alloc(sizes[a] * sizeof(int));
+        expected[a] = (int *)safe_alloc(sizes[a] * sizeof(int));
+    }
+
+    for (int round = 0; round < 2; round++) {
+        for (int a = 0; a < 3; a++) {
+            array_init_random(arrays[a], sizes[a], -ranges[a], ranges[a],
+                              seed++, num_threads);
+            memcpy(expected[a], arrays[a], sizes[a] * sizeof(int));
+            counting_sort(expected[a], sizes[a], num_threads);
+        }
+
+        if (round == 0)
+            for (int a = 0; a < 3; a++)
+                offload_counting_sort(ctx, arrays[a], sizes[a]);
+        else
+            offload_counting_sort_batch(ctx, arrays, sizes, 3);
+
+        for (int a = 0; a < 3; a++) {
+            if (memcmp(arrays[a], expected[a], sizes[a] * sizeof(int)) != 0) {
+                fprintf(stderr, "FAILED Offload sorting!\n"
+                                "Array %d of the %s differs from "
+                                "counting_sort()\n", a,
+                                round == 0 ? "single sorts" : "batch");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    for (int a = 0; a < 3; a++) {
+        free(arrays[a]);
+        free(expected[a]);
+    }
+    offload_ctx_destroy(ctx);
+    fprintf(stdout, "OK Offload sorting.\n");
+}
+
+
+void test_profile(int *array, long long size, int num_threads) {
+    array_init_random(array, size, RANGE_MIN, RANGE_MAX, seed++, num_threads);
+    int nslots = team_size(num_threads);
+    double elapsed = 0;
+
+    profile_start(num_threads);
+    START_TIME(elapsed);
+    counting_sort(array, size, num_threads);
+    END_TIME(elapsed);
+    profile_stop();
+    check_sorted(array, size, num_threads);
+
+    /* A thread can not have spent more time in the phases than the sort. */
+    double histogram = 0;
+    for (int t = 0; t < nslots; t++) {
+        double total = 0;
+        for (int p = 0; p < NUM_PHASES; p++) {
+            double seconds = profile_seconds(p, t);
+            if (seconds < 0) {
+                fprintf(stderr, "FAILED Profiling!\n"
+                                "Negative time for phase %s of thread %d\n",
+                                phase_name(p), t);
+                exit(EXIT_FAILURE);
+            }
+            total += seconds;
+        }
+        if (total > elapsed) {
+            fprintf(stderr, "FAILED Profiling!\n"
+                            "Thread %d spent %f s in the phases of a %f s "
+                            "sort\n", t, total, elapsed);
+            exit(EXIT_FAILURE);
+        }
+        histogram += profile_seconds(PHASE_HISTOGRAM, t);
+    }
+
+    /* Large arrays always go through the histogram kernel. */
+    if (size > 1 << 16 && histogram <= 0) {
+        fprintf(stderr, "FAILED Profiling!\n"
+                        "No time measured for the histogram\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* Nothing is measured once profiling is stopped. */
+    double before = profile_seconds(PHASE_HISTOGRAM, 0);
+    counting_sort(array, size, num_threads);
+    if (profile_seconds(PHASE_HISTOGRAM, 0) != before) {
+        fprintf(stderr, "FAILED Profiling!\n"
+                        "Time measured after profile_stop()\n");
+        exit(EXIT_FAILURE);
+    }
+    fprintf(stdout, "OK Profiling.\n");
+}
+
+
+void test_tuning(int *array, long long size, int num_threads) {
+    int *expected = (int *)safe_alloc(size * sizeof(int));
+    const char *kinds[] = {"static", "dynamic", "guided"};
+    const char *loops[] = {"zero_fill", "histogram", "merge", "scatter"};
+    char spec[64];
+
+    /*
+     * The result with the default settings is the reference; the range is
+     * wide enough for the shared histogram on small arrays.
+     */
+    for (int k = 0; k < 3; k++) {
+        array_init_random(array, size, -RANGE_MAX * 8, RANGE_MAX * 8, seed,
+                          num_threads);
+        memcpy(expected, array, size * sizeof(int));
+        counting_sort(expected, size, num_threads);
+
+        tuning_set_affinity((thread_affinity)k, num_threads);
+        for (int l = 0; l < NUM_LOOPS; l++) {
+            snprintf(spec, sizeof(spec), "%s=%s,%d", loops[l], kinds[k],
+                     k * 3);
+            schedule_parse(spec);
+        }
+        /* Applying a schedule returns the current one, then put it back. */
+        saved_schedule before = tuning_apply_schedule(LOOP_SCATTER);
+        tuning_restore_schedule(before);
+        counting_sort(array, size, num_threads);
+        saved_schedule after = tuning_apply_schedule(LOOP_SCATTER);
+        tuning_restore_schedule(after);
+        for (int l = 0; l < NUM_LOOPS; l++)
+            tuning_set_schedule((sort_loop)l, SCHEDULE_STATIC, 0);
+        if (memcmp(array, expected, size * sizeof(int)) != 0) {
+            fprintf(stderr, "FAILED Tuning!\n"
+                            "Wrong result with %s schedules\n", kinds[k]);
+            exit(EXIT_FAILURE);
+        }
+        if (after.kind != before.kind || after.chunk != before.chunk) {
+            fprintf(stderr, "FAILED Tuning!\n"
+                            "The sort left its %s schedule to the caller\n",
+                    kinds[k]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    tuning_set_affinity(AFFINITY_NONE, num_threads);
+    seed++;
+
+    /* The autotuner runs once per class; the profile file keeps it. */
+    char path[] = "/tmp/counting_sort_profile_XXXXXX";
+    close(mkstemp(path));
+    long long small = size < 100000 ? size : 100000;
+    int threads = tuning_best_threads(small, 0, RANGE_MAX, num_threads);
+    int max_threads = num_threads > 1 ? num_threads : 1;
+    if (threads < 1 || threads > max_threads ||
+        tuning_best_threads(small, 0, RANGE_MAX, num_threads) != threads) {
+        fprintf(stderr, "FAILED Tuning!\n"
+                        "Autotuner chose %d threads out of %d\n", threads,
+                        max_threads);
+        exit(EXIT_FAILURE);
+    }
+    tuning_save_profile(path);
+    tuning_load_profile(path);
+    if (tuning_best_threads(small, 0, RANGE_MAX, num_threads) != threads) {
+        fprintf(stderr, "FAILED Tuning!\n"
+                        "The profile file changed the thread count\n");
+        exit(EXIT_FAILURE);
+    }
+    unlink(path);
+
+    free(expected);
+    fprintf(stdout, "OK Tuning.\n");
+}
+
+
+void test_sort_batch(long long size, int num_threads) {
+    enum { NARRAYS = 8 };
+    int *arrays[NARRAYS], *expected[NARRAYS];
+    long long sizes[NARRAYS];
+
+    /*
+     * Two large arrays, one of them too wide to be counted, many small ones,
+     * an empty one and a small wide range.
+     */
+    for (int a = 0; a < NARRAYS; a++) {
+        sizes[a] = a < 2 ? size : (a == 2 ? 0 : size / (8 * a) + a);
+        int range = a == 1 ? INT_MAX / 4
+                  : (a == NARRAYS - 1 ? RANGE_MAX * 64 : RANGE_MAX);
+        arrays[a] = (int *)safe_alloc((sizes[a] + 1) * sizeof(int));
+        expected[a] = (int *)safe_alloc((sizes[a] + 1) * sizeof(int));
+        array_init_random(arrays[a], sizes[a], -range, range, seed++,
+                          num_threads);
+        memcpy(expected[a], arrays[a], sizes[a] * sizeof(int));
+        counting_sort(expected[a], sizes[a], num_threads);
+    }
+
+    counting_sort_batch(arrays, sizes, NARRAYS, num_threads);
+
+    for (int a = 0; a < NARRAYS; a++) {
+        if (memcmp(arrays[a], expected[a], sizes[a] * sizeof(int)) != 0) {
+            fprintf(stderr, "FAILED Batch Sorting!\n"
+                            "Array %d of %lld elements differs\n", a,
+                            sizes[a]);
+            exit(EXIT_FAILURE);
+        }
+        free(arrays[a]);
+        free(expected[a]);
+    }
+    fprintf(stdout, "OK Batch Sorting.\n");
+}
+
+
+void test_sort_strategies(counting_sort_ctx *ctx, int *array, long long size,
+                          int num_threads)
+{
+    int *expected = (int *)safe_alloc(size * sizeof(int));
+    /* Below 2^16 elements the sample is not taken. */
+    bool sampled = size > 65536;
+    struct {
+        const char *name;
+        int min, max, few;
+        long long outliers;
+        sort_strategy strategy;
+    } cases[] = {
+        {"dense", RANGE_MIN, RANGE_MAX, 0, 0, STRATEGY_DENSE},
+        {"outliers", RANGE_MIN, RANGE_MAX, 0, size / 1000,
+         STRATEGY_OUTLIER_SPLIT},
+        {"wide", INT_MIN, INT_MAX, 0, 0, STRATEGY_RADIX},
+        {"sparse", INT_MIN, INT_MAX, 64, 0, STRATEGY_SPARSE},
+    };
+
+    for (int c = 0; c < 4; c++) {
+        array_init_random(array, size, cases[c].min, cases[c].max, seed++,
+                          num_threads);
+        /* Few distinct values, spread over the whole range. */
+        for (long long i = 0; cases[c].few > 0 && i < size; i++)
+            array[i] = (int)(array[i] % cases[c].few) * (INT_MAX / 64);
+        for (long long i = 0; i < cases[c].outliers; i++)
+            array[i * 997 % size] = i % 2 == 0 ? INT_MIN + (int)i
+                                               : INT_MAX - (int)i;
+        memcpy(expected, array, size * sizeof(int));
+        radix_sort(expected, size, num_threads);
+
+        counting_sort_with_ctx(ctx, array, size);
+        const sort_decision *d = counting_sort_ctx_decision(ctx);
+        if (memcmp(array, expected, size * sizeof(int)) != 0) {
+            fprintf(stderr, "FAILED Strategies!\n"
+                            "Wrong result on %s values with %s\n",
+                            cases[c].name, strategy_name(d->strategy));
+            exit(EXIT_FAILURE);
+        }
+        /* Small arrays are sorted by whichever serial algorithm is cheaper. */
+        if (sampled && (d->strategy != cases[c].strategy ||
+                        d->outliers != cases[c].outliers)) {
+            fprintf(stderr, "FAILED Strategies!\n"
+                            "%s values sorted with %s, %lld outliers\n",
+                            cases[c].name, strategy_name(d->strategy),
+                            d->outliers);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    free(expected);
+    fprintf(stdout, "OK Strategies.\n");
+}
+
+
+void test_sort_histogram(int *array, long long size, int num_threads) {
+    long long half = size / 2, small = size / 100 + 1;
+    int *expected = (int *)safe_alloc((size + small) * sizeof(int));
+    int *out = (int *)safe_alloc((size + small) * sizeof(int));
+    int *extra = (int *)safe_alloc(small * sizeof(int));
+    sort_histogram *a = sort_histogram_create(num_threads);
+    sort_histogram *b = sort_histogram_create(num_threads);
+
+    /*
+     * Two halves in different histograms, the second one widening the range;
+     * a small batch (counted serially) added to the first and taken out again.
+     */
+    array_init_random(array, half, RANGE_MIN, RANGE_MAX, seed++, num_threads);
+    array_init_random(array + half, size - half, RANGE_MIN - RANGE_MAX,
+                      RANGE_MAX * 2, seed++, num_threads);
+    array_init_random(extra, small, RANGE_MIN, RANGE_MAX, seed++, num_threads);
+    sort_histogram_add(a, array, half);
+    sort_histogram_add(a, extra, small);
+    sort_histogram_add(b, array + half, size - half);
+    sort_histogram_remove(a, extra, small);
+    sort_histogram_merge(a, b);
+
+    memcpy(expected, array, size * sizeof(int));
+    counting_sort(expected, size, num_threads);
+    sort_histogram_materialize(a, out);
+    if (sort_histogram_size(a) != size ||
+        memcmp(out, expected, size * sizeof(int)) != 0) {
+        fprintf(stderr, "FAILED Sort histogram!\n"
+                        "Wrong sorted values after merging\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* Slices are the same positions of the whole sorted sequence. */
+    long long k = size / 3 < 10 ? size / 3 : 10;
+    sort_histogram_top(a, out, k);
+    sort_histogram_materialize_range(a, out + k, size / 3, size / 3 + k);
+    if (memcmp(out, expected + size - k, k * sizeof(int)) != 0 ||
+        memcmp(out + k, expected + size / 3, k * sizeof(int)) != 0) {
+        fprintf(stderr, "FAILED Sort histogram!\n"
+                        "Wrong top %lld values or slice\n", k);
+        exit(EXIT_FAILURE);
+    }
+
+    /* The histogram of the second half is left as it was. */
+    sort_histogram_remove(a, array + half, size - half);
+    sort_histogram_materialize(b, out);
+    sort_histogram_materialize(a, out + size - half);
+    counting_sort(array, half, num_threads);
+    counting_sort(array + half, size - half, num_threads);
+    if (memcmp(out, array + half, (size - half) * sizeof(int)) != 0 ||
+        memcmp(out + size - half, array, half * sizeof(int)) != 0) {
+        fprintf(stderr, "FAILED Sort histogram!\n"
+                        "Wrong sorted values after a removal\n");
+        exit(EXIT_FAILURE);
+    }
+
+    sort_histogram_destroy(a);
+    sort_histogram_destroy(b);
+    free(expected);
+    free(out);
+    free(extra);
+    fprintf(stdout, "OK Sort histogram.\n");
+}
+
+
+/** @brief Compare two `int`s; to be used with qsort(). */
+static int int_compare(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+
+void test_fuzz(int max_threads, int rounds) {
+    const char *entries[] = {"counting_sort", "counting_sort_with_ctx",
+                             "counting_sort_batch", "sort_histogram"};
+    const char *dists[] = {"uniform", "zipf", "normal", "equal", "sorted",
+                           "reverse", "few"};
+    long long max_size = 1LL << FUZZ_MAX_BITS;
+    int *array = (int *)safe_alloc(max_size * sizeof(int));
+    int *expected = (int *)safe_alloc(max_size * sizeof(int));
+    unsigned state = (unsigned)seed++;
+
+    for (int r = 0; r < rounds; r++) {
+        /* Sizes spread evenly on a logarithmic scale, 0 and 1 included. */
+        long long size = rand_r(&state) % (1LL << (rand_r(&state) %
+                                                   (FUZZ_MAX_BITS + 1)));
+        /* Ranges from a single value to all the integers. */
+        long long span = (long long)UINT32_MAX >> (rand_r(&state) % 33);
+        long long lo = INT_MIN + (long long)(rand_r(&state) /
+                                             (double)RAND_MAX *
+                                             ((long long)UINT32_MAX - span));
+        int min = lo, max = lo + span;
+        distribution dist = (distribution)(rand_r(&state) % (DIST_FEW + 1));
+        int threads = max_threads > 0 ? 1 + rand_r(&state) % max_threads : 0;
+        int entry = rand_r(&state) % 4;
+        uint64_t case_seed = seed++;
+        /* The range of a histogram is limited. */
+        bool outliers = entry != 3 && rand_r(&state) % 4 == 0;
+        if (entry == 3 && span >= HISTOGRAM_MAX_RANGE)
+            entry = 0;
+
+        array_init_distribution(array, size, min, max, dist, case_seed,
+                                threads);
+        /* Now and then, a few values far from all the others. */
+        for (int k = 0; outliers && size > 0 && k < 3; k++)
+            array[rand_r(&state) % size] = k % 2 ? INT_MAX : INT_MIN;
+        memcpy(expected, array, size * sizeof(int));
+
+        if (entry == 0) {
+            qsort(expected, size, sizeof(int), int_compare);
+            counting_sort(array, size, threads);
+        }
+        else if (entry == 1) {
+            counting_sort_ctx *ctx = counting_sort_ctx_create(threads);
+            qsort(expected, size, sizeof(int), int_compare);
+            counting_sort_with_ctx(ctx, array, size);
+            counting_sort_ctx_destroy(ctx);
+        }
+        else if (entry == 2) {
+            /* Three adjacent pieces of the array, each sorted on its own. */
+            long long cut1 = size / 7, cut2 = size / 2;
+            int *arrays[3] = {array, array + cut1, array + cut2};
+            long long sizes[3] = {cut1, cut2 - cut1, size - cut2};
+            for (int a = 0; a < 3; a++)
+                qsort(expected + (arrays[a] - array), sizes[a], sizeof(int),
+                      int_compare);
+            counting_sort_batch(arrays, sizes, 3, threads);
+        }
+        else {
+            sort_histogram *hist = sort_histogram_create(threads);
+            qsort(expected, size, sizeof(int), int_compare);
+            sort_histogram_add(hist, array, size);
+            sort_histogram_materialize(hist, array);
+            sort_histogram_destroy(hist);
+        }
+
+        if (memcmp(array, expected, size * sizeof(int)) != 0) {
+            fprintf(stderr, "FAILED Fuzzing!\n"
+                            "%s differs from qsort() on %lld %s values in "
+                            "[%d, %d], seed %llu, %d threads\n",
+                            entries[entry], size, dists[dist], min, max,
+                            (unsigned long long)case_seed, threads);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    free(array);
+    free(expected);
+    fprintf(stdout, "OK Fuzzing (%d cases).\n", rounds);
 }